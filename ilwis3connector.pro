@@ -37,7 +37,11 @@ SOURCES += \
     ilwis3connector/ilwis3catalogconnector.cpp \
     ilwis3connector/ilwis3projectionconnector.cpp \
     ilwis3connector/RawConverter.cpp \
-    ilwis3connector/featureconnector.cpp
+    ilwis3connector/featureconnector.cpp \
+    ilwis3connector/arrowfile.cpp \
+    ilwis3connector/featureindex.cpp \
+    ilwis3connector/keyindex.cpp \
+    ilwis3connector/sidecarfile.cpp
 
 HEADERS += \
     ilwis3connector/ilwis3connector_global.h \
@@ -58,7 +62,11 @@ HEADERS += \
     ilwis3connector/odfitem.h \
     ilwis3connector/ilwis3catalogconnector.h \
     ilwis3connector/ilwis3projectionconnector.h \
-    ilwis3connector/featureconnector.h
+    ilwis3connector/featureconnector.h \
+    ilwis3connector/arrowfile.h \
+    ilwis3connector/featureindex.h \
+    ilwis3connector/keyindex.h \
+    ilwis3connector/sidecarfile.h
 
 
 win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../libraries/$$PLATFORM$$CONF/core/ -lilwiscore
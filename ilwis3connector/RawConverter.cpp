@@ -1,9 +1,33 @@
+#include <algorithm>
 #include "ilwis.h"
 #include "rawconverter.h"
 
 using namespace Ilwis;
 using namespace Ilwis3;
 
+// the bulk conversions pick the specialized functor once; the loops themselves have no branches
+
+void RawConverter::raw2real(const qint32 *raw, quint64 count, double *real) const {
+    if ( isNeutral())
+        std::transform(raw, raw + count, real, RawDecoder<qint32, true>(*this));
+    else
+        std::transform(raw, raw + count, real, RawDecoder<qint32, false>(*this));
+}
+
+void RawConverter::raw2real(const double *raw, quint64 count, double *real) const {
+    if ( isNeutral())
+        std::transform(raw, raw + count, real, RawDecoder<double, true>(*this));
+    else
+        std::transform(raw, raw + count, real, RawDecoder<double, false>(*this));
+}
+
+void RawConverter::real2raw(const double *real, quint64 count, qint32 *raw) const {
+    if ( isNeutral())
+        std::transform(real, real + count, raw, RawEncoder<qint32, true>(*this));
+    else
+        std::transform(real, real + count, raw, RawEncoder<qint32, false>(*this));
+}
+
 RawConverter::RawConverter(double low, double high, double step)  {
     _storeType =  minNeededStoreType(low, high, step);
     _offset = determineOffset(low, high, step, _storeType);
@@ -0,0 +1,721 @@
+#include <QString>
+#include <QFile>
+#include <QHash>
+#include <cstring>
+
+#include "kernel.h"
+#include "arrowfile.h"
+
+using namespace Ilwis;
+using namespace Ilwis3;
+
+namespace {
+
+// constants of the Arrow flatbuffer schema (Schema.fbs, Message.fbs)
+const quint8 MESSAGE_SCHEMA = 1;
+const quint8 MESSAGE_DICTIONARYBATCH = 2;
+const quint8 MESSAGE_RECORDBATCH = 3;
+const quint8 TYPE_INT = 2;
+const quint8 TYPE_FLOATINGPOINT = 3;
+const quint8 TYPE_FIXEDSIZELIST = 16;
+const quint8 TYPE_LARGEBINARY = 19;
+const quint8 TYPE_LARGELIST = 21;
+const qint16 METADATA_V5 = 4;
+const qint16 PRECISION_DOUBLE = 2;
+
+/*
+ Builds a flatbuffer front to back. A table is written before the tables, vectors and strings it refers to,
+ so its offset fields are placeholders that are linked once the child has been written; flatbuffer offsets
+ point forward, which is exactly what this order gives.
+ */
+class FlatBuilder
+{
+public:
+    struct Slot{
+        quint16 _id;
+        quint8 _size; // 0 for an offset to a table, vector or string
+        quint64 _value;
+    };
+
+    FlatBuilder() {
+        put<quint32>(0); // offset to the root table
+    }
+
+    template<typename T> quint32 put(T v) {
+        align(sizeof(T));
+        quint32 at = _buf.size();
+        _buf.insert(_buf.end(), (const char *)&v, (const char *)&v + sizeof(T));
+        return at;
+    }
+
+    void align(quint32 n) {
+        while ( _buf.size() % n != 0)
+            _buf.push_back(0);
+    }
+
+    void link(quint32 at, quint32 target) {
+        quint32 offset = target - at;
+        memcpy(&_buf[at], &offset, 4);
+    }
+
+    void root(quint32 table) {
+        link(0, table);
+    }
+
+    // writes the vtable and the table; links receives the positions of the offset slots, in slot order
+    quint32 table(const std::vector<Slot>& slots, std::vector<quint32>& links) {
+        quint16 fields = 0;
+        for(const Slot& slot : slots)
+            fields = std::max(fields, (quint16)(slot._id + 1));
+        std::vector<quint16> positions(fields, 0);
+        std::vector<quint16> where(slots.size(), 0);
+        quint16 inlineSize = 4;
+        for(quint8 size : {8, 4, 2, 1}) { // largest first keeps every field aligned in an 8 aligned table
+            for(quint32 i = 0; i < slots.size(); ++i) {
+                if ( (slots[i]._size == 0 ? 4 : slots[i]._size) != size)
+                    continue;
+                inlineSize = (inlineSize + size - 1) / size * size;
+                where[i] = inlineSize;
+                positions[slots[i]._id] = inlineSize;
+                inlineSize += size;
+            }
+        }
+        align(2);
+        quint32 vtable = put<quint16>(4 + 2 * fields);
+        put<quint16>(inlineSize);
+        for(quint16 position : positions)
+            put<quint16>(position);
+        align(8);
+        quint32 start = put<qint32>(0);
+        qint32 soffset = start - vtable; // the vtable precedes the table
+        memcpy(&_buf[start], &soffset, 4);
+        _buf.resize(start + inlineSize, 0);
+        links.clear();
+        for(quint32 i = 0; i < slots.size(); ++i) {
+            if ( slots[i]._size == 0)
+                links.push_back(start + where[i]);
+            else
+                memcpy(&_buf[start + where[i]], &slots[i]._value, slots[i]._size);
+        }
+        return start;
+    }
+
+    quint32 string(const QByteArray& s) {
+        quint32 at = put<quint32>(s.size());
+        _buf.insert(_buf.end(), s.constData(), s.constData() + s.size());
+        _buf.push_back(0);
+        return at;
+    }
+
+    // vector of offsets; links receives the position of each element
+    quint32 offsets(quint32 count, std::vector<quint32>& links) {
+        quint32 at = put<quint32>(count);
+        links.clear();
+        for(quint32 i = 0; i < count; ++i)
+            links.push_back(put<quint32>(0));
+        return at;
+    }
+
+    // vector of structs; the elements, not the length, have to be 8 aligned
+    quint32 structs(const void *data, quint32 count, quint32 size) {
+        align(4);
+        if ( (_buf.size() + 4) % 8 != 0)
+            put<quint32>(0);
+        quint32 at = put<quint32>(count);
+        _buf.insert(_buf.end(), (const char *)data, (const char *)data + count * size);
+        return at;
+    }
+
+    const std::vector<char>& buffer() const {
+        return _buf;
+    }
+
+private:
+    std::vector<char> _buf;
+};
+
+// read access to a table in a flatbuffer; anything out of range reads as absent
+class FlatTable
+{
+public:
+    FlatTable(const char *buf=0, qint64 size=0, qint64 pos=0) : _buf(buf), _size(size), _pos(pos) {
+        if ( !buf || size < 4 || pos < 0 || pos + 4 > size)
+            _buf = 0;
+    }
+
+    static FlatTable root(const char *buf, qint64 size) {
+        quint32 pos = 0;
+        if ( size >= 4)
+            memcpy(&pos, buf, 4);
+        return FlatTable(buf, size, pos);
+    }
+
+    bool isValid() const {
+        return _buf != 0;
+    }
+
+    template<typename T> T scalar(quint16 id, T def) const {
+        qint64 at = field(id);
+        return at < 0 ? def : read<T>(at);
+    }
+
+    FlatTable table(quint16 id) const {
+        return FlatTable(_buf, _size, target(id));
+    }
+
+    FlatTable element(const char *vector, quint32 i) const {
+        qint64 at = (vector - _buf) + 4 * (qint64)i;
+        if ( !vector || at < 0 || at + 4 > _size)
+            return FlatTable();
+        return FlatTable(_buf, _size, at + read<quint32>(at));
+    }
+
+    const char *vector(quint16 id, quint32 elementSize, quint32& count) const {
+        count = 0;
+        qint64 at = target(id);
+        if ( at < 0)
+            return 0;
+        quint32 n = read<quint32>(at);
+        if ( at + 4 + (qint64)n * elementSize > _size)
+            return 0;
+        count = n;
+        return _buf + at + 4;
+    }
+
+    QString string(quint16 id) const {
+        qint64 at = target(id);
+        if ( at < 0)
+            return sUNDEF;
+        quint32 length = read<quint32>(at);
+        if ( at + 4 + (qint64)length > _size)
+            return sUNDEF;
+        return QString::fromUtf8(_buf + at + 4, length);
+    }
+
+private:
+    const char *_buf;
+    qint64 _size;
+    qint64 _pos;
+
+    template<typename T> T read(qint64 at) const {
+        T v = 0;
+        if ( _buf && at >= 0 && at + (qint64)sizeof(T) <= _size)
+            memcpy(&v, _buf + at, sizeof(T));
+        return v;
+    }
+
+    qint64 field(quint16 id) const {
+        if ( !_buf)
+            return -1;
+        qint64 vtable = _pos - read<qint32>(_pos);
+        if ( vtable < 0 || vtable + 4 > _size)
+            return -1;
+        quint16 vsize = read<quint16>(vtable);
+        if ( 4 + 2 * id + 2 > vsize || vtable + vsize > _size)
+            return -1;
+        quint16 offset = read<quint16>(vtable + 4 + 2 * id);
+        if ( offset == 0 || _pos + offset >= _size)
+            return -1;
+        return _pos + offset;
+    }
+
+    qint64 target(quint16 id) const {
+        qint64 at = field(id);
+        if ( at < 0 || at + 4 > _size)
+            return -1;
+        qint64 to = at + read<quint32>(at);
+        return to + 4 <= _size ? to : -1;
+    }
+};
+
+struct TypeSpec{
+    quint8 _type;
+    qint32 _param; // bit width or list size
+    std::vector<TypeSpec> _children;
+};
+
+struct FieldNode{
+    qint64 _length;
+    qint64 _nullCount;
+};
+
+struct BufferSpec{
+    qint64 _offset;
+    qint64 _length;
+};
+
+struct Block{
+    qint64 _offset;
+    qint32 _metaDataLength;
+    qint32 _padding;
+    qint64 _bodyLength;
+};
+
+// offsets of a binary or list column: rising and within the values buffer
+bool validOffsets(const quint64 *offsets, quint64 count, quint64 values) {
+    for(quint64 i = 0; i < count; ++i) {
+        if ( offsets[i] > offsets[i + 1])
+            return false;
+    }
+    return offsets[count] <= values;
+}
+
+// the nodes and buffers of a record batch; values are never null so validity buffers are empty
+struct Body{
+    Body() : _size(0) {}
+
+    void node(qint64 length) {
+        FieldNode node = {length, 0};
+        _nodes.push_back(node);
+        buffer(0, 0);
+    }
+
+    void buffer(const char *data, quint64 size) {
+        BufferSpec spec = {(qint64)_size, (qint64)size};
+        _buffers.push_back(spec);
+        _data.push_back(std::make_pair(data, size));
+        _size += (size + 7) / 8 * 8;
+    }
+
+    std::vector<FieldNode> _nodes;
+    std::vector<BufferSpec> _buffers;
+    std::vector<std::pair<const char *, quint64>> _data;
+    quint64 _size;
+};
+
+TypeSpec typeSpec(ArrowFile::ColumnType type) {
+    TypeSpec float64 = {TYPE_FLOATINGPOINT, 0, {}};
+    TypeSpec point = {TYPE_FIXEDSIZELIST, 2, {float64}};
+    switch(type) {
+    case ArrowFile::ctINT32:
+        return {TYPE_INT, 32, {}};
+    case ArrowFile::ctFLOAT64:
+        return float64;
+    case ArrowFile::ctCOORD2D:
+        return point;
+    case ArrowFile::ctCOORD3D:
+        return {TYPE_FIXEDSIZELIST, 3, {float64}};
+    case ArrowFile::ctCOORDLIST:
+        return {TYPE_LARGELIST, 0, {point}};
+    default: // strings, plain or as the values of a dictionary
+        return {TYPE_LARGEBINARY, 0, {}};
+    }
+}
+
+quint32 writeIntType(FlatBuilder& b, qint32 bits) {
+    std::vector<quint32> links;
+    return b.table({{0, 4, (quint64)bits}, {1, 1, 1}}, links);
+}
+
+quint32 writeType(FlatBuilder& b, const TypeSpec& spec) {
+    std::vector<quint32> links;
+    switch(spec._type) {
+    case TYPE_INT:
+        return writeIntType(b, spec._param);
+    case TYPE_FLOATINGPOINT:
+        return b.table({{0, 2, (quint64)PRECISION_DOUBLE}}, links);
+    case TYPE_FIXEDSIZELIST:
+        return b.table({{0, 4, (quint64)spec._param}}, links);
+    default: // LargeBinary and LargeList have no fields
+        return b.table({}, links);
+    }
+}
+
+quint32 writeField(FlatBuilder& b, const QString& name, const TypeSpec& spec, qint64 dictionary) {
+    std::vector<FlatBuilder::Slot> slots = {{0, 0, 0}, {2, 1, spec._type}, {3, 0, 0}, {5, 0, 0}};
+    if ( dictionary >= 0)
+        slots.push_back({4, 0, 0});
+    std::vector<quint32> links;
+    quint32 field = b.table(slots, links);
+    b.link(links[0], b.string(name.toUtf8()));
+    b.link(links[1], writeType(b, spec));
+    std::vector<quint32> children;
+    b.link(links[2], b.offsets(spec._children.size(), children));
+    for(quint32 i = 0; i < spec._children.size(); ++i)
+        b.link(children[i], writeField(b, "item", spec._children[i], -1));
+    if ( dictionary >= 0) { // dictionary id and int32 indices
+        std::vector<quint32> encoding;
+        b.link(links[3], b.table({{0, 8, (quint64)dictionary}, {1, 0, 0}}, encoding));
+        b.link(encoding[0], writeIntType(b, 32));
+    }
+    return field;
+}
+
+quint32 writeSchema(FlatBuilder& b, const std::vector<ArrowFile::Column>& columns, const QHash<QString, QString>& metadata) {
+    std::vector<quint32> links, fields, keyValues;
+    quint32 schema = b.table({{1, 0, 0}, {2, 0, 0}}, links);
+    b.link(links[0], b.offsets(columns.size(), fields));
+    for(quint32 c = 0; c < columns.size(); ++c) {
+        qint64 dictionary = columns[c]._type == ArrowFile::ctDICTIONARY ? (qint64)c : -1;
+        b.link(fields[c], writeField(b, columns[c]._name, typeSpec(columns[c]._type), dictionary));
+    }
+    b.link(links[1], b.offsets(metadata.size(), keyValues));
+    quint32 i = 0;
+    for(auto iter = metadata.begin(); iter != metadata.end(); ++iter, ++i) {
+        std::vector<quint32> keyValue;
+        b.link(keyValues[i], b.table({{0, 0, 0}, {1, 0, 0}}, keyValue));
+        b.link(keyValue[0], b.string(iter.key().toUtf8()));
+        b.link(keyValue[1], b.string(iter.value().toUtf8()));
+    }
+    return schema;
+}
+
+quint32 writeRecordBatch(FlatBuilder& b, quint64 length, const Body& body) {
+    std::vector<quint32> links;
+    quint32 batch = b.table({{0, 8, length}, {1, 0, 0}, {2, 0, 0}}, links);
+    b.link(links[0], b.structs(body._nodes.data(), body._nodes.size(), sizeof(FieldNode)));
+    b.link(links[1], b.structs(body._buffers.data(), body._buffers.size(), sizeof(BufferSpec)));
+    return batch;
+}
+
+// encapsulated message: continuation marker, metadata size, the Message flatbuffer padded to 8 bytes
+template<typename Func> Block writeMessage(QFile& file, quint8 headerType, quint64 bodyLength, Func header) {
+    FlatBuilder b;
+    std::vector<quint32> links;
+    quint32 message = b.table({{0, 2, (quint64)METADATA_V5}, {1, 1, headerType}, {2, 0, 0}, {3, 8, bodyLength}}, links);
+    b.root(message);
+    b.link(links[0], header(b));
+    b.align(8);
+    Block block = {file.pos(), 0, 0, (qint64)bodyLength};
+    quint32 marker = 0xFFFFFFFF;
+    qint32 size = b.buffer().size();
+    file.write((const char *)&marker, 4);
+    file.write((const char *)&size, 4);
+    file.write(b.buffer().data(), size);
+    block._metaDataLength = 8 + size;
+    return block;
+}
+
+void writeBody(QFile& file, const Body& body) {
+    static const char padding[8] = {0};
+    for(const auto& buffer : body._data) {
+        if ( buffer.second > 0)
+            file.write(buffer.first, buffer.second);
+        file.write(padding, (8 - buffer.second % 8) % 8);
+    }
+}
+
+void addColumn(Body& body, const ArrowFile::Column& col, quint64 rows) {
+    switch(col._type) {
+    case ArrowFile::ctINT32:
+    case ArrowFile::ctDICTIONARY:
+        body.node(rows);
+        body.buffer(col._data, rows * 4);
+        break;
+    case ArrowFile::ctFLOAT64:
+        body.node(rows);
+        body.buffer(col._data, rows * 8);
+        break;
+    case ArrowFile::ctCOORD2D:
+    case ArrowFile::ctCOORD3D: {
+        quint64 dim = col._type == ArrowFile::ctCOORD2D ? 2 : 3;
+        body.node(rows);
+        body.node(rows * dim);
+        body.buffer(col._data, rows * dim * 8);
+        break;
+    }
+    case ArrowFile::ctBINARY:
+        body.node(rows);
+        body.buffer((const char *)col._offsets, (rows + 1) * 8);
+        body.buffer(col._data, col._dataSize);
+        break;
+    case ArrowFile::ctCOORDLIST: {
+        quint64 coords = col._offsets[rows];
+        body.node(rows);
+        body.buffer((const char *)col._offsets, (rows + 1) * 8);
+        body.node(coords);
+        body.node(coords * 2);
+        body.buffer(col._data, coords * 16);
+        break;
+    }
+    }
+}
+}
+
+ArrowFile::ArrowFile() : _map(0), _size(0), _rows(0)
+{
+}
+
+bool ArrowFile::write(const QString &filename, quint64 rows, const std::vector<Column> &columns, const QHash<QString, QString> &metadata)
+{
+    QFile file(filename);
+    if ( !file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    file.write("ARROW1\0\0", 8);
+    writeMessage(file, MESSAGE_SCHEMA, 0, [&](FlatBuilder& b) {
+        return writeSchema(b, columns, metadata);
+    });
+
+    std::vector<Block> dictionaries;
+    for(quint32 c = 0; c < columns.size(); ++c) {
+        const Column& col = columns[c];
+        if ( col._type != ctDICTIONARY)
+            continue;
+        Body body;
+        body.node(col._dictCount);
+        body.buffer((const char *)col._dictOffsets, (col._dictCount + 1) * 8);
+        body.buffer(col._dictData, col._dictOffsets[col._dictCount]);
+        dictionaries.push_back(writeMessage(file, MESSAGE_DICTIONARYBATCH, body._size, [&](FlatBuilder& b) {
+            std::vector<quint32> links;
+            quint32 batch = b.table({{0, 8, c}, {1, 0, 0}}, links);
+            b.link(links[0], writeRecordBatch(b, col._dictCount, body));
+            return batch;
+        }));
+        writeBody(file, body);
+    }
+
+    Body body;
+    for(const Column& col : columns)
+        addColumn(body, col, rows);
+    Block batch = writeMessage(file, MESSAGE_RECORDBATCH, body._size, [&](FlatBuilder& b) {
+        return writeRecordBatch(b, rows, body);
+    });
+    writeBody(file, body);
+
+    quint32 eos[2] = {0xFFFFFFFF, 0};
+    file.write((const char *)eos, 8);
+
+    FlatBuilder b;
+    std::vector<quint32> links;
+    quint32 footer = b.table({{0, 2, (quint64)METADATA_V5}, {1, 0, 0}, {2, 0, 0}, {3, 0, 0}}, links);
+    b.root(footer);
+    b.link(links[0], writeSchema(b, columns, metadata));
+    b.link(links[1], b.structs(dictionaries.data(), dictionaries.size(), sizeof(Block)));
+    b.link(links[2], b.structs(&batch, 1, sizeof(Block)));
+    qint32 footerSize = b.buffer().size();
+    file.write(b.buffer().data(), footerSize);
+    file.write((const char *)&footerSize, 4);
+    file.write("ARROW1", 6);
+
+    return file.error() == QFile::NoError;
+}
+
+bool ArrowFile::open(const QString &filename)
+{
+    _file.setFileName(filename);
+    if ( !_file.open(QIODevice::ReadOnly))
+        return false;
+    _size = _file.size();
+    if ( _size < 32)
+        return false;
+    _map = (const char *)_file.map(0, _size);
+    if ( !_map)
+        return false;
+    if ( memcmp(_map, "ARROW1", 6) != 0 || memcmp(_map + _size - 6, "ARROW1", 6) != 0)
+        return false;
+    qint32 footerSize;
+    memcpy(&footerSize, _map + _size - 10, 4);
+    qint64 footerPos = _size - 10 - (qint64)footerSize;
+    if ( footerSize <= 0 || footerPos < 8)
+        return false;
+    FlatTable footer = FlatTable::root(_map + footerPos, footerSize);
+    FlatTable schema = footer.table(1);
+    if ( !schema.isValid())
+        return false;
+
+    quint32 count;
+    const char *fields = schema.vector(1, 4, count);
+    for(quint32 i = 0; i < count; ++i) {
+        FlatTable field = schema.element(fields, i);
+        FlatTable type = field.table(3);
+        Column col;
+        col._name = field.string(0);
+        switch(field.scalar<quint8>(2, 0)) {
+        case TYPE_INT:
+            if ( type.scalar<qint32>(0, 0) != 32)
+                return false;
+            col._type = ctINT32;
+            break;
+        case TYPE_FLOATINGPOINT:
+            if ( type.scalar<qint16>(0, 0) != PRECISION_DOUBLE)
+                return false;
+            col._type = ctFLOAT64;
+            break;
+        case TYPE_FIXEDSIZELIST: {
+            qint32 size = type.scalar<qint32>(0, 0);
+            if ( size != 2 && size != 3)
+                return false;
+            col._type = size == 2 ? ctCOORD2D : ctCOORD3D;
+            break;
+        }
+        case TYPE_LARGEBINARY: {
+            // dictionary ids are chosen by the writer; the indices have to be int32
+            FlatTable encoding = field.table(4);
+            col._type = encoding.isValid() ? ctDICTIONARY : ctBINARY;
+            if ( encoding.isValid()) {
+                FlatTable indexType = encoding.table(1);
+                if ( indexType.isValid() && indexType.scalar<qint32>(0, 0) != 32)
+                    return false;
+                _dictionaries[encoding.scalar<qint64>(0, 0)] = _columns.size();
+            }
+            break;
+        }
+        case TYPE_LARGELIST:
+            col._type = ctCOORDLIST;
+            break;
+        default:
+            return false;
+        }
+        _columns.push_back(col);
+    }
+    const char *keyValues = schema.vector(2, 4, count);
+    for(quint32 i = 0; i < count; ++i) {
+        FlatTable keyValue = schema.element(keyValues, i);
+        _metadata[keyValue.string(0)] = keyValue.string(1);
+    }
+
+    if ( _columns.empty())
+        return false;
+    const char *blocks = footer.vector(2, sizeof(Block), count);
+    for(quint32 i = 0; i < count; ++i) {
+        Block block;
+        memcpy(&block, blocks + i * sizeof(Block), sizeof(Block));
+        if (!readBatch(block._offset, block._metaDataLength, true))
+            return false;
+    }
+    blocks = footer.vector(3, sizeof(Block), count);
+    if ( count != 1)
+        return false;
+    Block block;
+    memcpy(&block, blocks, sizeof(Block));
+    return readBatch(block._offset, block._metaDataLength, false);
+}
+
+bool ArrowFile::readBatch(qint64 offset, qint64 metaLength, bool dictionary)
+{
+    // everything is checked against the mapping before it is used: the message, the body and every buffer
+    if ( offset < 8 || offset % 8 != 0 || metaLength < 8 || metaLength > _size - offset)
+        return false;
+    quint32 marker;
+    qint32 flatSize;
+    memcpy(&marker, _map + offset, 4);
+    memcpy(&flatSize, _map + offset + 4, 4);
+    if ( marker != 0xFFFFFFFF || flatSize <= 0 || flatSize > metaLength - 8)
+        return false;
+    const char *meta = _map + offset + 8;
+    FlatTable message = FlatTable::root(meta, flatSize);
+    quint8 headerType = message.scalar<quint8>(1, 0);
+    qint64 bodyLength = message.scalar<qint64>(3, 0);
+    qint64 bodyPos = offset + metaLength;
+    const char *body = _map + bodyPos;
+    if ( bodyLength < 0 || bodyLength > _size - bodyPos)
+        return false;
+    FlatTable batch = message.table(2);
+    qint64 id = -1;
+    if ( dictionary) {
+        if ( headerType != MESSAGE_DICTIONARYBATCH)
+            return false;
+        id = batch.scalar<qint64>(0, 0);
+        batch = batch.table(1);
+    } else if ( headerType != MESSAGE_RECORDBATCH)
+        return false;
+    if ( !batch.isValid())
+        return false;
+
+    // every row or dictionary entry takes at least one byte of the body, which bounds all sizes computed below
+    qint64 length = batch.scalar<qint64>(0, -1);
+    if ( length < 0 || length > bodyLength)
+        return false;
+    quint32 count;
+    const char *buffers = batch.vector(2, sizeof(BufferSpec), count);
+    quint32 next = 0;
+    // the next buffer of the body; 0 when it is missing, not 8 aligned or does not fit the body
+    auto buffer = [&](quint64 needed) -> const char * {
+        if ( next >= count)
+            return 0;
+        BufferSpec spec;
+        memcpy(&spec, buffers + sizeof(BufferSpec) * next++, sizeof(BufferSpec));
+        if ( spec._offset < 0 || spec._length < 0 || spec._offset > bodyLength || spec._length > bodyLength - spec._offset)
+            return 0;
+        if ( (quint64)spec._length < needed || (bodyPos + spec._offset) % 8 != 0)
+            return 0;
+        return body + spec._offset;
+    };
+
+    if ( dictionary) {
+        auto iter = _dictionaries.find(id);
+        if ( iter == _dictionaries.end())
+            return false;
+        Column& col = _columns[iter.value()];
+        buffer(0);
+        col._dictOffsets = (const quint64 *)buffer((length + 1) * 8);
+        if ( !col._dictOffsets || length > 0xFFFFFFFFLL || col._dictOffsets[length] > (quint64)bodyLength)
+            return false;
+        col._dictData = buffer(col._dictOffsets[length]);
+        col._dictCount = length;
+        return col._dictData != 0 && validOffsets(col._dictOffsets, length, col._dictOffsets[length]);
+    }
+
+    _rows = length;
+    for(Column& col : _columns) {
+        buffer(0);
+        switch(col._type) {
+        case ctINT32:
+        case ctDICTIONARY:
+            col._dataSize = _rows * 4;
+            col._data = buffer(col._dataSize);
+            break;
+        case ctFLOAT64:
+            col._dataSize = _rows * 8;
+            col._data = buffer(col._dataSize);
+            break;
+        case ctCOORD2D:
+        case ctCOORD3D:
+            buffer(0);
+            col._dataSize = _rows * (col._type == ctCOORD2D ? 16 : 24);
+            col._data = buffer(col._dataSize);
+            break;
+        case ctBINARY:
+            col._offsets = (const quint64 *)buffer((_rows + 1) * 8);
+            if ( !col._offsets || col._offsets[_rows] > (quint64)bodyLength)
+                return false;
+            col._dataSize = col._offsets[_rows];
+            col._data = buffer(col._dataSize);
+            if ( col._data && !validOffsets(col._offsets, _rows, col._dataSize))
+                return false;
+            break;
+        case ctCOORDLIST:
+            col._offsets = (const quint64 *)buffer((_rows + 1) * 8);
+            if ( !col._offsets || col._offsets[_rows] > (quint64)bodyLength / 16)
+                return false;
+            buffer(0);
+            buffer(0);
+            col._dataSize = col._offsets[_rows] * 16;
+            col._data = buffer(col._dataSize);
+            if ( col._data && !validOffsets(col._offsets, _rows, col._offsets[_rows]))
+                return false;
+            break;
+        }
+        if ( !col._data)
+            return false;
+        if ( col._type == ctDICTIONARY) { // codes refer to entries of the dictionary read before
+            if ( !col._dictOffsets)
+                return false;
+            const qint32 *codes = (const qint32 *)col._data;
+            for(quint64 r = 0; r < _rows; ++r) {
+                if ( codes[r] < 0 || (quint32)codes[r] >= col._dictCount)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+quint64 ArrowFile::rows() const
+{
+    return _rows;
+}
+
+QString ArrowFile::metadata(const QString &key) const
+{
+    return _metadata.value(key, sUNDEF);
+}
+
+const ArrowFile::Column *ArrowFile::column(const QString &name) const
+{
+    for(const Column& col : _columns) {
+        if ( col._name == name)
+            return &col;
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#ifndef ARROWFILE_H
+#define ARROWFILE_H
+
+#include <QFile>
+
+namespace Ilwis {
+namespace Ilwis3{
+
+/*!
+ \brief minimal writer and reader of Arrow IPC files (format version 5) holding a single record batch.
+
+ Only the column layouts a decoded ILWIS3 table needs are supported: int32, float64, fixed size lists of
+ float64 for coordinates, large binary for strings (optionally dictionary encoded) and large lists of
+ coordinates for coordinate buffers. Values are never null; ILWIS undefined values are kept as they are.
+ Files are written without any external dependency and can be read by any Arrow implementation. Reading
+ maps the file; the column pointers refer to the mapping and stay valid as long as the ArrowFile exists.
+ */
+class ArrowFile
+{
+public:
+    enum ColumnType{ ctINT32, ctFLOAT64, ctCOORD2D, ctCOORD3D, ctBINARY, ctCOORDLIST, ctDICTIONARY };
+
+    struct Column{
+        Column() : _type(ctINT32), _data(0), _dataSize(0), _offsets(0), _dictOffsets(0), _dictData(0), _dictCount(0) {}
+        QString _name;
+        ColumnType _type;
+        const char *_data; // values, string or coordinate payload, or the codes of a dictionary column
+        quint64 _dataSize; // in bytes
+        const quint64 *_offsets; // rows + 1; bytes for ctBINARY, coordinates for ctCOORDLIST
+        const quint64 *_dictOffsets; // _dictCount + 1 byte offsets into _dictData
+        const char *_dictData;
+        quint32 _dictCount;
+    };
+
+    ArrowFile();
+
+    static bool write(const QString& filename, quint64 rows, const std::vector<Column>& columns, const QHash<QString, QString>& metadata);
+
+    bool open(const QString& filename);
+    quint64 rows() const;
+    QString metadata(const QString& key) const;
+    const Column *column(const QString& name) const;
+
+private:
+    QFile _file;
+    const char *_map;
+    qint64 _size;
+    quint64 _rows;
+    std::vector<Column> _columns;
+    QHash<QString, QString> _metadata;
+    QHash<qint64, quint32> _dictionaries; // column of each dictionary id
+
+    bool readBatch(qint64 offset, qint64 metaLength, bool dictionary);
+};
+}
+}
+
+#endif // ARROWFILE_H
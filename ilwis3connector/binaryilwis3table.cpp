@@ -1,5 +1,11 @@
 #include <QString>
 #include <QFile>
+#include <QFileInfo>
+#include <thread>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 #include "kernel.h"
 #include "angle.h"
@@ -17,33 +23,22 @@
 #include "numericrange.h"
 #include "RawConverter.h"
 #include "binaryilwis3table.h"
+#include "arrowfile.h"
+#include "sidecarfile.h"
 
 
 using namespace Ilwis ;
 using namespace Ilwis3;
 
-BinaryIlwis3Table::BinaryIlwis3Table() : _rows(0), _columns(0),_recordSize(0),_records(0), _loaded(false)
+BinaryIlwis3Table::BinaryIlwis3Table() : _rows(0), _columns(0), _completeRows(0), _rowWidth(0), _filterMin(iUNDEF), _filterMax(iUNDEF), _loaded(false)
 {
 }
 
-BinaryIlwis3Table::~BinaryIlwis3Table(){
-    for(quint32 r = 0; r < _rows; ++r) {
-        for(quint32 c = 0; c < _columns; ++c) {
-            const ColumnInfo& info = _columnInfo.at(c);
-            char *p = _records + r * _recordSize + info._offset;
-            if ( info._type == itBINARY){ //binaries are coords in this case
-                vector<Coordinate> *coords = ( vector<Coordinate> *)(*(long *)p);
-                delete coords;
-            }
-            else if	( info._type == itSTRING) {
-                //delete p;
-            }
-        }
-    }
-    delete [] _records;
+BinaryIlwis3Table::~BinaryIlwis3Table()
+{
 }
 
-bool BinaryIlwis3Table::load(const ODF& odf, const QString& prfix){
+bool BinaryIlwis3Table::load(const ODF& odf, const QString& prfix, const QStringList& columns, bool cache){
     Locker lock(_mutex);
     if( _loaded)
         return true;
@@ -75,27 +70,69 @@ bool BinaryIlwis3Table::load(const ODF& odf, const QString& prfix){
     }
 
     getColumnInfo(odf, prefix);
+    if ( columns.size() > 0) {
+        for(ColumnInfo& info : _columnInfo)
+            info._selected = columns.contains(info._name);
+    }
 
+    // rows of a fixed width are found by position, whether they are decoded or come from the cache
     qint64 size = file.size();
-    char *memblock = new char [size];
-    file.seek (0);
-    file.read (memblock, size);
-    file.close();
+    _rowWidth = fixedRowWidth();
+    _rowStarts.clear();
+    _completeRows = _rowWidth > 0 ? std::min((qint64)_rows, std::max((qint64)0, size - 128) / _rowWidth) : 0;
 
-    _records = new char [ _recordSize * _rows];
-    memset(_records, 0,_recordSize * _rows);
+    // a valid columnar cache is used as it is; nothing needs to be decoded
+    bool filtering = _envelopeColumns.size() == 2 || !_selection.empty();
+    if ( cache && !filtering && readCache(QFileInfo(file))) {
+        if ( _rowWidth == 0)
+            readRowIndex(QFileInfo(file), size);
+        _loaded = true;
+        return true;
+    }
 
-    readData(memblock);
+    // decode straight from a mapping of the file; only when that fails fall back to reading it in memory.
+    // The mapping saves the copy of the file, not time: the row index and measure pass read the whole
+    // file before the first row is decoded, and load only returns when all rows are decoded
+    bool complete = false;
+    uchar *mapped = file.map(0, size);
+    if ( mapped) {
+        complete = readData((const char *)mapped, size, true, QFileInfo(file));
+        file.unmap(mapped);
+    } else {
+        char *memblock = new char [size];
+        file.seek (0);
+        file.read (memblock, size);
+        complete = readData(memblock, size, false, QFileInfo(file));
+        delete[] memblock;
+    }
+    file.close();
 
-    delete[] memblock;
+    if (!complete)
+        kernel()->issues()->log(TR(ERR_COULD_NOT_LOAD_2).arg("table", odf->fileinfo().baseName()));
+    else if ( cache && !filtering)
+        writeCache(QFileInfo(file));
 
     _loaded = true;
     return true;
 }
 
+void BinaryIlwis3Table::selectEnvelope(const QString &minColumn, const QString &maxColumn, const double envelope[4]) {
+    // only has effect before loading; rows whose extents (two coordinate columns) are outside the envelope are not decoded
+    _envelopeColumns = {minColumn, maxColumn};
+    std::copy(envelope, envelope + 4, _envelope);
+}
+
+void BinaryIlwis3Table::selectRows(const std::vector<char> &rows) {
+    // only has effect before loading; rows beyond the selection are not decoded, empty selects all
+    _selection = rows;
+}
+
+bool BinaryIlwis3Table::selected(quint32 row) const {
+    return _rowFilter.empty() || (row < _rowFilter.size() && _rowFilter[row]);
+}
+
 void BinaryIlwis3Table::getColumnInfo(const ODF& odf, const QString& prefix) {
     _columnInfo.resize(_columns);
-    _recordSize = 0;
 
     for(quint32 col = 0 ; col < _columns; ++col) {
         ColumnInfo inf;
@@ -108,41 +145,26 @@ void BinaryIlwis3Table::getColumnInfo(const ODF& odf, const QString& prefix) {
             return ;
         }
         inf._name = name;
-        QString range = odf->value(section,"Range");
-        QStringList parts = range.split(":");
-        inf._isRaw = ( parts.size() == 4 || parts.size() == 3) && st != "Real";
-        if ( st == "Long" ){
-            inf._offset = _recordSize;
-            _recordSize+=4;
-            inf._type = itINT32;
-        } if ( st == "Int" ){ // in practice same as long
-            inf._offset = _recordSize;
-            _recordSize+=4;
-            inf._type = itINT32;
-        } if ( st == "Byte" ){ // in practive same as long
-            inf._offset = _recordSize;
-            _recordSize+=4;
+        inf._range = odf->value(section, "Range");
+        inf._selected = true;
+        inf._width = 0;
+        inf._type = itUNKNOWN;
+        if ( st == "Long" || st == "Int" || st == "Byte"){ // in practice all stored as long
+            inf._width = 4;
             inf._type = itINT32;
         } else if ( st == "String" ) {
-            inf._offset = _recordSize;
             inf._type = itSTRING;
-            _recordSize+=4;
         } else if ( st == "CoordBuf" ) {
-            inf._offset = _recordSize;
-            _recordSize+=4;
             inf._type = itBINARY;
         }
         else if ( st == "Real"){
-            inf._offset = _recordSize;
-            _recordSize+=8;
+            inf._width = 8;
             inf._type  = itDOUBLE;
         } else if ( st == "Coord" ) {
-            inf._offset = _recordSize;
-            _recordSize += 16;
+            inf._width = 16;
             inf._type = itCOORD2D;
         } else if ( st == "Coord3D" ) {
-            inf._offset = _recordSize;
-            _recordSize += 24;
+            inf._width = 24;
             inf._type = itCOORD3D;
         }
         _columnInfo[col] = inf;
@@ -150,74 +172,449 @@ void BinaryIlwis3Table::getColumnInfo(const ODF& odf, const QString& prefix) {
     }
 }
 
-void BinaryIlwis3Table::readData(char *memblock) {
-    long posFile = 128;
+void BinaryIlwis3Table::releasePages(const char *memblock, qint64 from, qint64 to) const {
+#ifdef Q_OS_UNIX
+    // pages that have been decoded are not needed anymore; keeps the resident part of the mapping small
+    static const qint64 pageSize = sysconf(_SC_PAGESIZE);
+    qint64 start = ((qint64)(memblock + from) + pageSize - 1) / pageSize * pageSize;
+    qint64 end = (qint64)(memblock + to) / pageSize * pageSize;
+    if ( end > start)
+        madvise((void *)start, end - start, MADV_DONTNEED);
+#endif
+}
+
+bool BinaryIlwis3Table::readData(const char *memblock, qint64 size, bool mapped, const QFileInfo& datafile) {
+#ifdef Q_OS_UNIX
+    if ( mapped)
+        madvise((void *)memblock, size, MADV_SEQUENTIAL);
+#endif
+    _columnData.assign(_columns, ColumnData());
+    for(quint32 c = 0; c < _columns; ++c) {
+        const ColumnInfo& info = _columnInfo.at(c);
+        ColumnData& data = _columnData[c];
+        if ( !info._selected)
+            continue;
+        if ( info._type == itINT32)
+            data._ints.resize(_rows, iUNDEF);
+        else if ( info._type == itDOUBLE)
+            data._doubles.resize(_rows, rUNDEF);
+        else if ( info._type == itCOORD2D || info._type == itCOORD3D)
+            data._doubles.resize(_rows * (info._width / 8), rUNDEF);
+        else if ( info._type == itSTRING || info._type == itBINARY) {
+            data._offsets.resize(_rows + 1, 0);
+        }
+    }
+
+    if ( _rowWidth == 0 && !readRowIndex(datafile, size)) {
+        buildRowIndex(memblock, size);
+        writeRowIndex(datafile);
+    }
+    quint32 completeRows = _completeRows;
+
+    _rowFilter = _selection;
+    if ( !_rowFilter.empty())
+        _rowFilter.resize(_rows, 0);
+    _filterMin = _filterMax = iUNDEF;
+    if ( _envelopeColumns.size() == 2) {
+        quint32 colMin = index(_envelopeColumns[0]);
+        quint32 colMax = index(_envelopeColumns[1]);
+        auto isCoord = [&](quint32 col) { return col != iUNDEF && (_columnInfo.at(col)._type == itCOORD2D || _columnInfo.at(col)._type == itCOORD3D); };
+        if ( isCoord(colMin) && isCoord(colMax)) {
+            _filterMin = colMin;
+            _filterMax = colMax;
+            if ( _rowFilter.empty())
+                _rowFilter.assign(_rows, 1);
+        }
+    }
+    measure(memblock, completeRows);
+
+    // all variable length payloads go into one arena, each column in its own 8 byte aligned part
+    quint64 arenaSize = 0;
+    for(ColumnData& data : _columnData) {
+        if ( data._offsets.size() == 0)
+            continue;
+        data._base = arenaSize;
+        arenaSize += (data._offsets.back() + 7) / 8 * 8;
+    }
+    _arena.assign(arenaSize / 8, 0);
+
+    forBands(0, completeRows, ROWCHUNK, [&](quint32 first, quint32 last) {
+        decode(memblock, first, last, mapped);
+    });
+
+    bool encoded = false;
+    for(quint32 c = 0; c < _columns; ++c) {
+        if ( _columnInfo.at(c)._selected && _columnInfo.at(c)._type == itSTRING)
+            encoded |= encodeStrings(c);
+    }
+    if ( encoded)
+        compactArena();
+    setViews();
+
+    return completeRows == _rows;
+}
+
+void BinaryIlwis3Table::setViews() {
+    for(ColumnData& data : _columnData) {
+        data._intValues = data._ints.data();
+        data._doubleValues = data._doubles.data();
+        data._offsetValues = data._offsets.data();
+        data._payload = (const char *)_arena.data() + data._base;
+    }
+}
+
+QString BinaryIlwis3Table::cacheFile(const QFileInfo &datafile) {
+    return datafile.absoluteFilePath() + ".arrow";
+}
+
+bool BinaryIlwis3Table::readCache(const QFileInfo &datafile) {
+    SidecarFile sidecar(cacheFile(datafile), 0, {datafile});
+    QScopedPointer<ArrowFile> cache(new ArrowFile());
+    if ( !cache->open(sidecar.filename()) || cache->rows() != _rows || cache->metadata("ilwis3.source") != sidecar.stamp())
+        return false;
+
+    std::vector<ColumnData> columnData(_columns);
+    for(quint32 c = 0; c < _columns; ++c) {
+        const ColumnInfo& info = _columnInfo.at(c);
+        ColumnData& data = columnData[c];
+        if ( !info._selected || info._type == itUNKNOWN)
+            continue;
+        const ArrowFile::Column *col = cache->column(info._name);
+        if ( !col)
+            return false;
+        if ( info._type == itINT32 && col->_type == ArrowFile::ctINT32) {
+            data._intValues = (const qint32 *)col->_data;
+        } else if ( info._type == itDOUBLE && col->_type == ArrowFile::ctFLOAT64) {
+            data._doubleValues = (const double *)col->_data;
+        } else if ( (info._type == itCOORD2D && col->_type == ArrowFile::ctCOORD2D) ||
+                    (info._type == itCOORD3D && col->_type == ArrowFile::ctCOORD3D)) {
+            data._doubleValues = (const double *)col->_data;
+        } else if ( info._type == itSTRING && col->_type == ArrowFile::ctBINARY) {
+            data._offsetValues = col->_offsets;
+            data._payload = col->_data;
+        } else if ( info._type == itSTRING && col->_type == ArrowFile::ctDICTIONARY) {
+            data._intValues = (const qint32 *)col->_data;
+            for(quint32 r = 0; r < _rows; ++r) {
+                if ( data._intValues[r] < 0 || data._intValues[r] >= (qint32)col->_dictCount)
+                    return false;
+            }
+            data._dictionary.resize(col->_dictCount);
+            data._strings.resize(col->_dictCount);
+            for(quint32 i = 0; i < col->_dictCount; ++i) {
+                quint64 begin = col->_dictOffsets[i];
+                data._dictionary[i] = QByteArray(col->_dictData + begin, col->_dictOffsets[i + 1] - begin);
+                data._strings[i] = QString::fromLatin1(data._dictionary[i]);
+            }
+            data._encoded = true;
+        } else if ( info._type == itBINARY && col->_type == ArrowFile::ctCOORDLIST) {
+            // the cache counts coordinates, the table bytes
+            data._offsets.resize(_rows + 1);
+            for(quint32 r = 0; r <= _rows; ++r)
+                data._offsets[r] = col->_offsets[r] * 16;
+            data._offsetValues = data._offsets.data();
+            data._payload = col->_data;
+        } else
+            return false;
+    }
+    _columnData.swap(columnData);
+    _cache.reset(cache.take());
+    return true;
+}
+
+void BinaryIlwis3Table::writeCache(const QFileInfo &datafile) const {
+    // only a complete table is cached; failing to write it is harmless. The values are the raw values of the data
+    // file, undefined ones included, because that is what the table hands out: the converters belong to the
+    // callers and item columns are keys, not reals. The metadata says so and gives each column's range
+    std::vector<ArrowFile::Column> columns;
+    std::vector<std::vector<quint64>> offsets(_columns); // converted offsets, alive until written
+    std::vector<QByteArray> dictionaries(_columns);
+    for(quint32 c = 0; c < _columns; ++c) {
+        const ColumnInfo& info = _columnInfo.at(c);
+        const ColumnData& data = _columnData[c];
+        if ( !info._selected)
+            return;
+        ArrowFile::Column col;
+        col._name = info._name;
+        if ( info._type == itINT32) {
+            col._type = ArrowFile::ctINT32;
+            col._data = (const char *)data._intValues;
+        } else if ( info._type == itDOUBLE) {
+            col._type = ArrowFile::ctFLOAT64;
+            col._data = (const char *)data._doubleValues;
+        } else if ( info._type == itCOORD2D || info._type == itCOORD3D) {
+            col._type = info._type == itCOORD2D ? ArrowFile::ctCOORD2D : ArrowFile::ctCOORD3D;
+            col._data = (const char *)data._doubleValues;
+        } else if ( info._type == itSTRING && data._encoded) {
+            col._type = ArrowFile::ctDICTIONARY;
+            col._data = (const char *)data._intValues;
+            offsets[c].push_back(0);
+            for(const QByteArray& value : data._dictionary) {
+                dictionaries[c].append(value);
+                offsets[c].push_back(dictionaries[c].size());
+            }
+            col._dictOffsets = offsets[c].data();
+            col._dictData = dictionaries[c].constData();
+            col._dictCount = data._dictionary.size();
+        } else if ( info._type == itSTRING) {
+            col._type = ArrowFile::ctBINARY;
+            col._data = data._payload;
+            col._dataSize = data._offsetValues[_rows];
+            col._offsets = data._offsetValues;
+        } else if ( info._type == itBINARY) {
+            col._type = ArrowFile::ctCOORDLIST;
+            offsets[c].resize(_rows + 1);
+            for(quint32 r = 0; r <= _rows; ++r)
+                offsets[c][r] = data._offsetValues[r] / 16;
+            col._data = data._payload;
+            col._dataSize = data._offsetValues[_rows];
+            col._offsets = offsets[c].data();
+        } else
+            continue;
+        columns.push_back(col);
+    }
+    SidecarFile sidecar(cacheFile(datafile), 0, {datafile});
+    QHash<QString, QString> metadata;
+    metadata["ilwis3.rows"] = QString::number(_rows);
+    metadata["ilwis3.source"] = sidecar.stamp();
+    metadata["ilwis3.values"] = "raw; real = (raw + offset) * step, from ilwis3.range.<column> (min:max:step:offset=); "
+                                "undefined are raw 0 and -2147483647 for int32, -1e308 for float64";
+    for(const ColumnInfo& info : _columnInfo) {
+        if ( info._range != sUNDEF)
+            metadata["ilwis3.range." + info._name] = info._range;
+    }
+    if ( ArrowFile::write(sidecar.temporary(), _rows, columns, metadata))
+        sidecar.commit();
+}
+
+bool BinaryIlwis3Table::encodeStrings(quint32 column) {
+    // string columns with few distinct values keep one copy of each value and a code per row
+    ColumnData& data = _columnData[column];
+    const char *text = (const char *)_arena.data() + data._base;
+    quint32 limit = std::max((quint32)MINDICTIONARY, _rows / 4);
+    QHash<QByteArray, qint32> codes;
+    std::vector<qint32> rowCodes(_rows);
+    std::vector<QByteArray> dictionary;
     for(quint32 r = 0; r < _rows; ++r) {
+        const char *value = text + data._offsets[r];
+        quint64 length = data._offsets[r + 1] - data._offsets[r];
+        auto iter = codes.find(QByteArray::fromRawData(value, length));
+        if ( iter != codes.end()) {
+            rowCodes[r] = iter.value();
+            continue;
+        }
+        if ( dictionary.size() >= limit) // mostly unique values; the plain layout is smaller
+            return false;
+        dictionary.push_back(QByteArray(value, length));
+        rowCodes[r] = dictionary.size() - 1;
+        codes.insert(dictionary.back(), rowCodes[r]);
+    }
+    data._ints.swap(rowCodes);
+    data._dictionary.swap(dictionary);
+    data._strings.resize(data._dictionary.size());
+    for(quint32 i = 0; i < data._dictionary.size(); ++i)
+        data._strings[i] = QString::fromLatin1(data._dictionary[i]);
+    data._encoded = true;
+    return true;
+}
+
+void BinaryIlwis3Table::compactArena() {
+    // the payload of dictionary encoded columns is not needed anymore
+    quint64 arenaSize = 0;
+    for(ColumnData& data : _columnData) {
+        if ( data._offsets.size() > 0 && !data._encoded)
+            arenaSize += (data._offsets.back() + 7) / 8 * 8;
+    }
+    std::vector<double> arena(arenaSize / 8);
+    quint64 base = 0;
+    for(ColumnData& data : _columnData) {
+        if ( data._offsets.size() == 0)
+            continue;
+        if ( data._encoded) {
+            std::vector<quint64>().swap(data._offsets);
+            continue;
+        }
+        memcpy((char *)arena.data() + base, (const char *)_arena.data() + data._base, data._offsets.back());
+        data._base = base;
+        base += (data._offsets.back() + 7) / 8 * 8;
+    }
+    _arena.swap(arena);
+}
+
+void BinaryIlwis3Table::decode(const char *memblock, quint32 first, quint32 last, bool mapped) {
+    char *arena = (char *)_arena.data();
+    qint64 released = rowStart(first);
+    for(quint32 r = first; r < last; ++r) {
+        qint64 posFile = rowStart(r);
+        if ( mapped && (r - first) % ROWCHUNK == 0 && r > first) {
+            releasePages(memblock, released, posFile);
+            released = posFile;
+        }
+        if ( !_rowFilter.empty() && !_rowFilter[r]) // the row index makes skipping free
+            continue;
         for(quint32 c = 0; c < _columns; ++c) {
             const ColumnInfo& info = _columnInfo.at(c);
-            char *p = _records + r * _recordSize + info._offset;
+            ColumnData& data = _columnData[c];
+            if ( !info._selected) { // fixed width is a plain skip, variable width only needs its length
+                if ( info._type == itSTRING)
+                    posFile += strlen(memblock + posFile) + 1;
+                else if ( info._type == itBINARY)
+                    posFile += *(const qint32 *)(memblock + posFile) + 4;
+                else
+                    posFile += info._width;
+                continue;
+            }
             if(  info._type == itINT32){
-                long l1 = *(long *)(memblock + posFile);
-                *(long *)p = *(long *)(memblock + posFile);
-                posFile += 4;
+                data._ints[r] = *(const qint32 *)(memblock + posFile);
              }else if ( info._type == itDOUBLE) {
-                *(double *)p = *(double *)(memblock + posFile);
-                //v33 = *(double *)p;
-                posFile += 8;
+                data._doubles[r] = *(const double *)(memblock + posFile);
             } else if ( info._type == itCOORD2D) {
-                memcpy(p,memblock + posFile,16);
-                //c33= *(double *)p;
-                posFile += 16;
+                memcpy(&data._doubles[r * 2], memblock + posFile, 16);
             } else if ( info._type == itCOORD3D) {
-                memcpy(p,memblock + posFile,24);
-                posFile += 24;
+                memcpy(&data._doubles[r * 3], memblock + posFile, 24);
             } else if ( info._type == itSTRING) {
-                *(long *)p = *(long *)readString(memblock + posFile);
-                posFile+= ((QString *)p)->size() + 1;
+                quint64 length = data._offsets[r + 1] - data._offsets[r];
+                memcpy(arena + data._base + data._offsets[r], memblock + posFile, length);
+                posFile += length + 1;
             } else if ( info._type == itBINARY) {
-                long cnt = 0;
-                *(long *)p = (long)readCoordList(memblock + posFile, cnt);
-                posFile += cnt;
+                quint64 bytes = data._offsets[r + 1] - data._offsets[r];
+                memcpy(arena + data._base + data._offsets[r], memblock + posFile + 4, bytes);
+                posFile += bytes + 4;
             }
+            posFile += info._width;
         }
     }
 }
 
-QString *BinaryIlwis3Table::readString(char *mem) {
-    char c;
-    QString *txt = new QString();
-    while((c = *(mem) ) != 0) {
-        (*txt)+= c;
-        ++mem;
+qint64 BinaryIlwis3Table::fixedRowWidth() const {
+    // bytes per row, 0 when a column has cells of variable length
+    qint64 rowWidth = 0;
+    for(const ColumnInfo& info : _columnInfo) {
+        if ( info._width == 0)
+            return 0;
+        rowWidth += info._width;
     }
-    return txt;
+    return rowWidth;
+}
+
+void BinaryIlwis3Table::buildRowIndex(const char *memblock, qint64 size) {
+    // start of every complete row in the data file plus the end of the last one
+    _rowStarts.clear();
+    _rowStarts.reserve(_rows + 1);
+    _completeRows = 0;
+    qint64 posFile = 128;
+    _rowStarts.push_back(posFile);
+    for(quint32 r = 0; r < _rows; ++r) {
+        for(quint32 c = 0; c < _columns; ++c) {
+            const ColumnInfo& info = _columnInfo.at(c);
+            quint32 needed = info._type == itSTRING ? 1 : std::max(info._width, (quint32)4);
+            if ( posFile + needed > size)
+                return;
+            if ( info._type == itSTRING) {
+                const char *begin = memblock + posFile;
+                const char *end = (const char *)memchr(begin, 0, size - posFile);
+                if ( end == 0)
+                    return;
+                posFile += end - begin + 1;
+            } else if ( info._type == itBINARY) {
+                qint32 bytes = *(const qint32 *)(memblock + posFile);
+                if ( bytes < 0 || posFile + 4 + bytes > size)
+                    return;
+                posFile += 4 + bytes;
+            }
+            posFile += info._width;
+        }
+        _rowStarts.push_back(posFile);
+        _completeRows = r + 1;
+    }
+}
+
+QString BinaryIlwis3Table::rowIndexFile(const QFileInfo &datafile) {
+    return datafile.absoluteFilePath() + ".rix";
 }
 
-char *BinaryIlwis3Table::readCoordList(char *mem, long& count) {
-    count = *(long *)mem;
-    long noCoords = count / 16;
-    vector<Coordinate> *coords = new vector<Coordinate>(noCoords);
-    for(int i=0; i < noCoords; ++i) {
-        double x = *(double *)(mem + 4 + i * sizeof(double) * 2);
-        double y = *(double *)(mem + 4 + sizeof(double) * (i * 2 + 1));
-        coords->at(i) = Coordinate(x,y,0);
+bool BinaryIlwis3Table::readRowIndex(const QFileInfo& datafile, qint64 size) {
+    SidecarFile sidecar(rowIndexFile(datafile), "RIX2", {datafile});
+    qint64 bytes;
+    const quint64 *starts = (const quint64 *)sidecar.map(bytes);
+    quint64 count = bytes / sizeof(quint64);
+    if ( !starts || bytes % sizeof(quint64) != 0 || count == 0 || count > (quint64)_rows + 1 ||
+         starts[0] != 128 || starts[count - 1] > (quint64)size)
+        return false;
+    _rowStarts.assign(starts, starts + count);
+    _completeRows = count - 1;
+    return true;
+}
+
+void BinaryIlwis3Table::writeRowIndex(const QFileInfo& datafile) const {
+    // only worthwhile for large tables; failing to write it is harmless
+    if ( _rowStarts.size() <= ROWCHUNK)
+        return;
+    SidecarFile sidecar(rowIndexFile(datafile), "RIX2", {datafile});
+    if ( sidecar.create() && sidecar.write(_rowStarts.data(), _rowStarts.size() * sizeof(quint64)))
+        sidecar.commit();
+}
+
+void BinaryIlwis3Table::measure(const char *memblock, quint32 completeRows) {
+    // sizes of the variable length cells, per band in parallel, turned into offsets afterwards. The envelope
+    // filter is decided in the same walk; rows outside it stay empty
+    std::vector<quint32> variable;
+    for(quint32 c = 0; c < _columns; ++c) {
+        if ( _columnData[c]._offsets.size() > 0)
+            variable.push_back(c);
+    }
+    bool filtering = !_rowFilter.empty();
+    if ( variable.size() == 0 && !filtering)
+        return;
+    forBands(0, completeRows, ROWCHUNK, [&](quint32 first, quint32 last) {
+        std::vector<quint64> lengths(_columns, 0);
+        double minxy[2], maxxy[2];
+        for(quint32 r = first; r < last; ++r) {
+            if ( filtering && !_rowFilter[r]) // the row starts make skipping free
+                continue;
+            qint64 posFile = rowStart(r);
+            for(quint32 c = 0; c < _columns; ++c) {
+                const ColumnInfo& info = _columnInfo.at(c);
+                quint64 length = 0;
+                if ( c == _filterMin)
+                    memcpy(minxy, memblock + posFile, 16);
+                else if ( c == _filterMax)
+                    memcpy(maxxy, memblock + posFile, 16);
+                if ( info._type == itSTRING) {
+                    length = strlen(memblock + posFile);
+                    posFile += length + 1;
+                } else if ( info._type == itBINARY) {
+                    length = *(const qint32 *)(memblock + posFile);
+                    posFile += length + 4;
+                }
+                lengths[c] = length;
+                posFile += info._width;
+            }
+            if ( _filterMin != iUNDEF && (minxy[0] > _envelope[2] || maxxy[0] < _envelope[0] || minxy[1] > _envelope[3] || maxxy[1] < _envelope[1])) {
+                _rowFilter[r] = 0;
+                continue;
+            }
+            for(quint32 c : variable)
+                _columnData[c]._offsets[r + 1] = lengths[c];
+        }
+    });
+    for(quint32 c : variable) { // incomplete rows stay empty
+        std::vector<quint64>& offsets = _columnData[c]._offsets;
+        for(quint32 r = 1; r < offsets.size(); ++r)
+            offsets[r] += offsets[r - 1];
     }
-    count +=4;
-    return (char *)coords;
 }
 
 bool BinaryIlwis3Table::get(quint32 row, quint32 column, double& v ) const {
     if(!check(row, column))
         return false;
     const ColumnInfo& info = _columnInfo.at(column);
+    const ColumnData& data = _columnData[column];
     v = rUNDEF;
-    char *p = moveTo(row,  info);
-    if( info._isRaw  || info._type == itINT32){
-        long raw = p != 0 ? *(long *) p : iUNDEF;
-        v = raw;
+    if( info._type == itINT32){
+        v = data._intValues[row];
     }
     else  if ( info._type == itDOUBLE) {
-        v = *(double *)p;
+        v = data._doubleValues[row];
     }
     return true;
 }
@@ -226,10 +623,14 @@ bool BinaryIlwis3Table::get(quint32 row, quint32 column, Coordinate &c) const {
     if(!check(row, column))
         return false;
     const ColumnInfo& field = _columnInfo.at(column);
-    char *p = moveTo(row,  field);
-    c.x(*(double *)p);
-    c.y(*(double *)(p + sizeof(double)));
-    c.z(field._type == itCOORD3D ? *(double *)(p + sizeof(double)*2) : rUNDEF);
+    if ( field._type != itCOORD2D && field._type != itCOORD3D)
+        return false;
+    const ColumnData& data = _columnData[column];
+    bool is3D = field._type == itCOORD3D;
+    const double *p = data._doubleValues + row * (is3D ? 3 : 2);
+    c.x(p[0]);
+    c.y(p[1]);
+    c.z(is3D ? p[2] : rUNDEF);
 
     return true;
 }
@@ -237,10 +638,10 @@ bool BinaryIlwis3Table::get(quint32 row, quint32 column, Coordinate &c) const {
 bool BinaryIlwis3Table::get(quint32 row, quint32 column, QString& s) const {
     if(!check(row, column))
         return false;
-    const  ColumnInfo& field = _columnInfo.at(column);
-    char *p = moveTo(row,  field);
-    s = *(QString *)p;
-
+    const ColumnData& data = _columnData[column];
+    if ( _columnInfo.at(column)._type != itSTRING)
+        return false;
+    s = data._encoded ? data._strings[data._intValues[row]] : stringView(row, column).toString();
 
     return true;
 }
@@ -248,10 +649,14 @@ bool BinaryIlwis3Table::get(quint32 row, quint32 column, QString& s) const {
 bool BinaryIlwis3Table::get(quint32 row, quint32 column, vector<Coordinate> &coords) const {
     if(!check(row, column))
         return false;
-    const ColumnInfo& field = _columnInfo.at(column);
-    char *p = moveTo(row,  field);
-    vector<Coordinate> *crds = ( vector<Coordinate> *)(*(long *)p);
-    coords = *crds;
+    const ColumnData& data = _columnData[column];
+    if ( _columnInfo.at(column)._type != itBINARY)
+        return false;
+    quint32 count;
+    const double *xy = coordinateData(row, column, count);
+    coords.resize(count);
+    for(quint32 i = 0; i < count; ++i)
+        coords[i] = Coordinate(xy[i * 2], xy[i * 2 + 1], 0);
 
     return true;
 
@@ -260,21 +665,139 @@ bool BinaryIlwis3Table::get(quint32 row, quint32 column, vector<Coordinate> &coo
 bool BinaryIlwis3Table::get(quint32 row, quint32 column, vector<Coordinate2d> &coords) const {
     if(!check(row, column))
         return false;
-    const ColumnInfo& field = _columnInfo.at(column);
-    char *p = moveTo(row,  field);
-    vector<Coordinate2d> *crds = ( vector<Coordinate2d> *)(*(long *)p);
-    coords = *crds;
+    const ColumnData& data = _columnData[column];
+    if ( _columnInfo.at(column)._type != itBINARY)
+        return false;
+    quint32 count;
+    const double *xy = coordinateData(row, column, count);
+    coords.resize(count);
+    for(quint32 i = 0; i < count; ++i)
+        coords[i] = Coordinate2d(xy[i * 2], xy[i * 2 + 1]);
+
+    return true;
+
+}
 
+
+bool BinaryIlwis3Table::get(quint32 column, std::vector<double> &values, const RawConverter& conv) const {
+    // the real values of a complete numeric column in one go
+    if( column >= _columnData.size() || (_rows > 0 && !check(0, column)))
+        return false;
+    const ColumnInfo& info = _columnInfo.at(column);
+    const ColumnData& data = _columnData[column];
+    values.resize(_rows);
+    if( info._type == itINT32)
+        conv.raw2real(data._intValues, _rows, values.data());
+    else if ( info._type == itDOUBLE)
+        conv.raw2real(data._doubleValues, _rows, values.data());
+    else
+        values.assign(_rows, rUNDEF);
+    return true;
+}
+
+template<typename RawType, bool Neutral> static void toVariants(const RawType *raw, quint32 rows, const RawConverter& conv, std::vector<QVariant>& values) {
+    RawDecoder<RawType, Neutral> decode(conv);
+    for(quint32 r = 0; r < rows; ++r)
+        values[r] = decode(raw[r]);
+}
+
+bool BinaryIlwis3Table::get(quint32 column, std::vector<QVariant> &values, const RawConverter& conv) const {
+    // the real values of a complete numeric column, straight into the values a table takes
+    if( column >= _columnData.size() || (_rows > 0 && !check(0, column)))
+        return false;
+    const ColumnInfo& info = _columnInfo.at(column);
+    const ColumnData& data = _columnData[column];
+    values.resize(_rows);
+    bool neutral = conv.isNeutral();
+    if( info._type == itINT32 && neutral)
+        toVariants<qint32, true>(data._intValues, _rows, conv, values);
+    else if( info._type == itINT32)
+        toVariants<qint32, false>(data._intValues, _rows, conv, values);
+    else if ( info._type == itDOUBLE && neutral)
+        toVariants<double, true>(data._doubleValues, _rows, conv, values);
+    else if ( info._type == itDOUBLE)
+        toVariants<double, false>(data._doubleValues, _rows, conv, values);
+    else
+        values.assign(_rows, QVariant(rUNDEF));
+    return true;
+}
+
+bool BinaryIlwis3Table::get(quint32 column, std::vector<QVariant> &values) const {
+    if( column >= _columnData.size() || (_rows > 0 && !check(0, column)))
+        return false;
+    if ( _columnInfo.at(column)._type != itSTRING)
+        return false;
+    const ColumnData& data = _columnData[column];
+    values.resize(_rows);
+    for(quint32 r = 0; r < _rows; ++r) // encoded values are shared, not copied
+        values[r] = data._encoded ? data._strings[data._intValues[r]] : stringView(r, column).toString();
     return true;
+}
+
+BinaryIlwis3Table::StringView BinaryIlwis3Table::stringView(quint32 row, quint32 column) const {
+    StringView view = {"", 0};
+    if(!check(row, column) || _columnInfo.at(column)._type != itSTRING)
+        return view;
+    const ColumnData& data = _columnData[column];
+    if ( data._encoded) {
+        const QByteArray& value = data._dictionary[data._intValues[row]];
+        view._data = value.constData();
+        view._length = value.size();
+        return view;
+    }
+    view._data = data._payload + data._offsetValues[row];
+    view._length = data._offsetValues[row + 1] - data._offsetValues[row];
+    return view;
+}
+
+const double *BinaryIlwis3Table::coordinateData(quint32 row, quint32 column, quint32 &count) const {
+    count = 0;
+    if(!check(row, column) || _columnInfo.at(column)._type != itBINARY)
+        return 0;
+    const ColumnData& data = _columnData[column];
+    count = (data._offsetValues[row + 1] - data._offsetValues[row]) / 16;
+    return (const double *)(data._payload + data._offsetValues[row]);
+}
+
+const qint32 *BinaryIlwis3Table::intData(quint32 column) const {
+    // the raw values of a complete integer column; valid as long as the table exists
+    if ( column >= _columnData.size() || (_rows > 0 && !check(0, column)) || _columnInfo.at(column)._type != itINT32)
+        return 0;
+    return _columnData[column]._intValues;
+}
 
+const double *BinaryIlwis3Table::doubleData(quint32 column, quint32 &stride) const {
+    // the values of a complete real or coordinate column, stride values per row; valid as long as the table exists
+    stride = 0;
+    if ( column >= _columnData.size() || (_rows > 0 && !check(0, column)))
+        return 0;
+    IlwisTypes type = _columnInfo.at(column)._type;
+    if ( type == itDOUBLE)
+        stride = 1;
+    else if ( type == itCOORD2D)
+        stride = 2;
+    else if ( type == itCOORD3D)
+        stride = 3;
+    else
+        return 0;
+    return _columnData[column]._doubleValues;
 }
 
+CoordinateView BinaryIlwis3Table::coordinates(quint32 row, quint32 column) const {
+    quint32 count;
+    const double *xy = coordinateData(row, column, count);
+    return CoordinateView(xy, count);
+}
 
 inline bool BinaryIlwis3Table::check(quint32 row, quint32 col) const {
     if ( row >= _rows || col >= _columns) {
         kernel()->issues()->log(TR("Bounds error when accessing table"));
         return false;
     }
+    if ( !_columnInfo[col]._selected) {
+        kernel()->issues()->log(TR("Column %1 was not loaded").arg(_columnInfo[col]._name));
+        return false;
+    }
     return true;
 }
 
@@ -305,14 +828,20 @@ QString BinaryIlwis3Table::columnName(int index)
     return sUNDEF;
 }
 
-inline char *BinaryIlwis3Table::moveTo(int row, const  ColumnInfo& fld) const{
-    return (char *)(_records + row * _recordSize + fld._offset);
-}
-
-bool BinaryIlwis3Table::openOutput(const QString& basename, std::ofstream& output_file) {
+QString BinaryIlwis3Table::outputPath(const QString &basename) {
     QFileInfo inf(basename);
     QString dir = context()->workingCatalog()->location().toLocalFile();
-    QString filename = dir + "/" + inf.fileName();
+    return dir + "/" + inf.fileName();
+}
+
+bool BinaryIlwis3Table::openOutput(const QString& basename, std::ofstream& output_file, bool append) {
+    QString filename = outputPath(basename);
+    if ( append) { // new records go behind the existing ones, the header is already there
+        output_file.open(filename.toLatin1(),ios_base::out | ios_base::binary | ios_base::app);
+        if ( !output_file.is_open())
+            return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
+        return true;
+    }
     output_file.open(filename.toLatin1(),ios_base::out | ios_base::binary | ios_base::trunc);
     if ( !output_file.is_open())
         return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
@@ -345,67 +874,196 @@ void BinaryIlwis3Table::addStoreDefinition(const DataDefinition& def) {
     _columnInfo.push_back(inf);
 }
 
-void BinaryIlwis3Table::storeRecord(std::ofstream& output_file, const std::vector<QVariant>& rec, int skip) {
-    for(int x=0; x < rec.size(); ++x) {
-        if ( x == skip)
-            continue;
-        const RawConverter& conv = _columnInfo[x]._conv;
-        IlwisTypes tp = _columnInfo[x]._type;
-        if ( conv.isValid()) {
-            if ( conv.isNeutral()) {
-                if ( conv.storeType() == itINT32 && tp == itITEMDOMAIN) {
-                    long val = rec[x].value<long>() + 1;
-                    output_file.write((char *)&val, 4);
-                }
-                else if ( conv.storeType() != itDOUBLE)    {
-                    long val = rec[x].value<long>();
-                    output_file.write((char *)&val, 4);
-                } else {
-                    double val = rec[x].value<double>();
-                    output_file.write((char *)&val, 8);
-                }
-            } else {
-                double val = rec[x].value<double>();
-                long raw = conv.real2raw(val);
-                output_file.write((char *)&raw,  4);
-            }
-        }else {
-
-            if ( tp == itTEXTDOMAIN) {
-                QString s = rec[x].value<QString>();
-                QByteArray bytes = s.toLocal8Bit();
-                const char * ptr = bytes.data();
-                output_file.write(ptr, s.size());
-                char c = 0;
-                output_file.write(&c, 1);
-
-            } else if ( tp == itCOORDDOMAIN) {
-                if ( rec[x].type() == QMetaType::QVariantList) {
-                    const QList<QVariant> points = rec[x].toList();
-                    long size = points.size();
-                    output_file.write((char *)&size, 4);
-                    for(const QVariant& pnt : points) {
-                        Coordinate2d crd = pnt.value<Coordinate2d>();
-                        double v = crd.x();
-                        output_file.write((char *)&v, 8);
-                        v = crd.y();
-                        output_file.write((char *)&v, 8);
-                        v = 0;
-                        output_file.write((char *)&v, 8);
-                    }
-                } else {
-                    Coordinate2d crd =  rec[x].value<Coordinate2d>();
-                    double v = crd.x();
-                    output_file.write((char *)&v, 8);
-                    v = crd.y();
-                    output_file.write((char *)&v, 8);
-                    v = 0;
-                    output_file.write((char *)&v, 8);
-                }
-            }
+BinaryIlwis3Table::StoreKind BinaryIlwis3Table::storeKind(const ColumnInfo &info) {
+    const RawConverter& conv = info._conv;
+    if ( conv.isValid()) {
+        if ( !conv.isNeutral())
+            return skRAW;
+        if ( conv.storeType() == itINT32 && info._type == itITEMDOMAIN)
+            return skITEM;
+        return conv.storeType() != itDOUBLE ? skLONG : skREAL;
+    }
+    if ( info._type == itTEXTDOMAIN)
+        return skSTRING;
+    if ( info._type == itCOORDDOMAIN)
+        return skCOORD;
+    return skNONE;
+}
+
+template<typename T> static void appendValue(std::vector<char>& bytes, T v) {
+    const char *p = (const char *)&v;
+    bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+static void appendCoordinate(std::vector<char>& bytes, const Coordinate2d& crd) {
+    appendValue(bytes, crd.x());
+    appendValue(bytes, crd.y());
+    appendValue(bytes, 0.0);
+}
+
+void BinaryIlwis3Table::columnBatch(quint32 column, const std::vector<QVariant> &values, quint32 first, quint32 count, ColumnBatch &batch) const {
+    batch._count = count;
+    batch._ints.clear();
+    batch._reals.clear();
+    batch._strings.clear();
+    batch._coordinates.clear();
+    batch._list = false;
+    switch(storeKind(_columnInfo[column])) {
+    case skITEM:
+    case skLONG:
+        batch._ints.resize(count);
+        for(quint32 r = 0; r < count; ++r)
+            batch._ints[r] = values[first + r].value<long>();
+        break;
+    case skREAL:
+    case skRAW:
+        batch._reals.resize(count);
+        for(quint32 r = 0; r < count; ++r)
+            batch._reals[r] = values[first + r].value<double>();
+        break;
+    case skSTRING:
+        batch._strings.resize(count);
+        for(quint32 r = 0; r < count; ++r)
+            batch._strings[r] = values[first + r].value<QString>();
+        break;
+    case skCOORD:
+        batch._list = count > 0 && values[first].type() == QMetaType::QVariantList;
+        batch._coordinates.resize(count);
+        for(quint32 r = 0; r < count; ++r) {
+            const QVariant& value = values[first + r];
+            if ( batch._list) {
+                for(const QVariant& pnt : value.toList())
+                    batch._coordinates[r].push_back(pnt.value<Coordinate2d>());
+            } else
+                batch._coordinates[r].push_back(value.value<Coordinate2d>());
         }
+        break;
+    default:
+        break;
     }
 }
 
+void BinaryIlwis3Table::encodeColumn(quint32 column, const ColumnBatch &batch, EncodedColumn &encoded) const {
+    // the conversion is chosen once for the column; the loops below only deal with values
+    const RawConverter& conv = _columnInfo[column]._conv;
+    std::vector<char>& bytes = encoded._bytes;
+    std::vector<quint64>& ends = encoded._ends;
+    quint32 count = batch._count;
+    bytes.clear();
+    ends.resize(count);
+    switch(storeKind(_columnInfo[column])) {
+    case skITEM:
+        bytes.reserve(count * 4);
+        for(quint32 r = 0; r < count; ++r) {
+            appendValue(bytes, batch._ints[r] + 1);
+            ends[r] = bytes.size();
+        }
+        break;
+    case skLONG:
+        bytes.resize(count * 4);
+        memcpy(bytes.data(), batch._ints.data(), count * 4);
+        for(quint32 r = 0; r < count; ++r)
+            ends[r] = (r + 1) * 4;
+        break;
+    case skREAL:
+        bytes.resize(count * 8);
+        memcpy(bytes.data(), batch._reals.data(), count * 8);
+        for(quint32 r = 0; r < count; ++r)
+            ends[r] = (r + 1) * 8;
+        break;
+    case skRAW:
+        bytes.resize(count * 4);
+        conv.real2raw(batch._reals.data(), count, (qint32 *)bytes.data());
+        for(quint32 r = 0; r < count; ++r)
+            ends[r] = (r + 1) * 4;
+        break;
+    case skSTRING: {
+        // repeated values are converted once and written from the dictionary; latin1, like the reading side
+        QHash<QString, QByteArray> dictionary;
+        for(quint32 r = 0; r < count; ++r) {
+            const QString& value = batch._strings[r];
+            auto iter = dictionary.find(value);
+            if ( iter == dictionary.end())
+                iter = dictionary.insert(value, value.toLatin1());
+            const QByteArray& s = iter.value();
+            bytes.insert(bytes.end(), s.constData(), s.constData() + s.size() + 1); // including the terminating 0
+            ends[r] = bytes.size();
+        }
+        break;
+    }
+    case skCOORD:
+        for(quint32 r = 0; r < count; ++r) {
+            const std::vector<Coordinate2d>& points = batch._coordinates[r];
+            if ( batch._list)
+                appendValue(bytes, (qint32)points.size());
+            for(const Coordinate2d& crd : points)
+                appendCoordinate(bytes, crd);
+            ends[r] = bytes.size();
+        }
+        break;
+    default:
+        for(quint32 r = 0; r < count; ++r)
+            ends[r] = 0;
+    }
+}
+
+void BinaryIlwis3Table::storeColumns(std::ofstream &output_file, const std::vector<ColumnBatch> &columns, int skip) {
+    std::vector<char> buffer;
+    std::vector<quint64> ends;
+    encodeColumns(columns, skip, buffer, ends);
+    output_file.write(buffer.data(), buffer.size());
+}
+
+void BinaryIlwis3Table::encodeColumns(const std::vector<ColumnBatch> &columns, int skip, std::vector<char> &buffer, std::vector<quint64> &ends) const {
+    buffer.clear();
+    quint32 records = 0;
+    for(quint32 c = 0; c < columns.size(); ++c)
+        if ( c != skip)
+            records = std::max(records, columns[c]._count);
+    ends.resize(records);
+    if ( records == 0)
+        return;
+    std::vector<EncodedColumn> encoded(columns.size());
+    quint64 total = 0;
+    for(quint32 c = 0; c < columns.size(); ++c) {
+        if ( c == skip)
+            continue;
+        encodeColumn(c, columns[c], encoded[c]);
+        total += encoded[c]._bytes.size();
+    }
+    // interleave the column batches into records
+    buffer.resize(total);
+    char *out = buffer.data();
+    for(quint32 r = 0; r < records; ++r) {
+        for(quint32 c = 0; c < columns.size(); ++c) {
+            if ( c == skip)
+                continue;
+            const EncodedColumn& col = encoded[c];
+            quint64 begin = r == 0 ? 0 : col._ends[r - 1];
+            memcpy(out, col._bytes.data() + begin, col._ends[r] - begin);
+            out += col._ends[r] - begin;
+        }
+        ends[r] = out - buffer.data();
+    }
+}
 
+QString BinaryIlwis3Table::storeLayout(int skip) const {
+    // how each written column is encoded; equal layouts write equal records
+    QStringList layout;
+    for(quint32 c = 0; c < _columnInfo.size(); ++c) {
+        if ( c == skip)
+            continue;
+        const RawConverter& conv = _columnInfo[c]._conv;
+        layout << QString("%1:%2:%3:%4").arg(storeKind(_columnInfo[c])).arg(conv.offset(), 0, 'g', 17).arg(conv.scale(), 0, 'g', 17).arg(conv.storeType());
+    }
+    return layout.join(";");
+}
 
+void BinaryIlwis3Table::storeRecord(std::ofstream& output_file, const std::vector<QVariant>& rec, int skip) {
+    std::vector<ColumnBatch> columns(rec.size());
+    for(quint32 c = 0; c < rec.size(); ++c) {
+        if ( c != skip)
+            columnBatch(c, std::vector<QVariant>(1, rec[c]), 0, 1, columns[c]);
+    }
+    storeColumns(output_file, columns, skip);
+}
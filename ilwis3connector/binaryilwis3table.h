@@ -6,46 +6,176 @@ namespace Ilwis {
 namespace Ilwis3{
 
 
+/*!
+ \brief read only view on the coordinates of a CoordBuf cell.
+
+ CoordBuf cells are stored as x,y pairs, so the view is 2D; coordinate() adds a zero z for callers that
+ need a 3D coordinate. The view refers to the table's memory and is valid as long as the table exists.
+ */
+class CoordinateView
+{
+public:
+    class const_iterator : public std::iterator<std::bidirectional_iterator_tag, Coordinate2d> {
+    public:
+        const_iterator(const double *p=0) : _p(p) {}
+        Coordinate2d operator*() const { return Coordinate2d(_p[0], _p[1]); }
+        const_iterator& operator++() { _p += 2; return *this; }
+        const_iterator operator++(int) { const_iterator old(*this); _p += 2; return old; }
+        const_iterator& operator--() { _p -= 2; return *this; }
+        const_iterator operator--(int) { const_iterator old(*this); _p -= 2; return old; }
+        bool operator==(const const_iterator& iter) const { return _p == iter._p; }
+        bool operator!=(const const_iterator& iter) const { return _p != iter._p; }
+    private:
+        const double *_p;
+    };
+
+    CoordinateView(const double *xy=0, quint32 count=0) : _xy(xy), _count(count) {}
+
+    quint32 size() const { return _count; }
+    bool empty() const { return _count == 0; }
+    double x(quint32 i) const { return _xy[i * 2]; }
+    double y(quint32 i) const { return _xy[i * 2 + 1]; }
+    Coordinate2d operator[](quint32 i) const { return Coordinate2d(x(i), y(i)); }
+    Coordinate2d front() const { return (*this)[0]; }
+    Coordinate2d back() const { return (*this)[_count - 1]; }
+    Coordinate coordinate(quint32 i) const { return Coordinate(x(i), y(i), 0); }
+    const_iterator begin() const { return const_iterator(_xy); }
+    const_iterator end() const { return const_iterator(_xy + _count * 2); }
+    const double *data() const { return _xy; }
+
+private:
+    const double *_xy;
+    quint32 _count;
+};
+
+class ArrowFile;
+
 class BinaryIlwis3Table
 {
 public:
+    // read only view on a string cell; valid as long as the table exists
+    struct StringView {
+        const char *_data;
+        quint32 _length;
+        QString toString() const { return QString::fromLatin1(_data, _length); }
+    };
+
+    // values of one output column for a batch of records, converted once from the table's column
+    struct ColumnBatch {
+        ColumnBatch() : _count(0), _list(false) {}
+        std::vector<qint32> _ints; // item and integer columns
+        std::vector<double> _reals; // real columns, also those stored through a converter
+        std::vector<QString> _strings;
+        std::vector<std::vector<Coordinate2d>> _coordinates; // a single coordinate or the points of a coordbuf cell
+        quint32 _count;
+        bool _list; // coordbuf cells; the point count precedes the points
+    };
+
     BinaryIlwis3Table();
     ~BinaryIlwis3Table();
 
-    bool load(const ODF &odf, const QString &prfix="");
+    bool load(const ODF &odf, const QString &prfix="", const QStringList &columns=QStringList(), bool cache=false);
+    void selectEnvelope(const QString& minColumn, const QString& maxColumn, const double envelope[4]);
+    void selectRows(const std::vector<char>& rows);
+    bool selected(quint32 row) const;
 
     bool get(quint32 row, quint32 column, double &v) const;
     bool get(quint32 row, quint32 column, Coordinate &c) const;
     bool get(quint32 row, quint32 column, QString &s) const;
     bool get(quint32 row, quint32 column, vector<Coordinate>& coords) const;
     bool get(quint32 row, quint32 column, vector<Coordinate2d> &coords) const;
+    bool get(quint32 column, std::vector<double>& values, const RawConverter& conv) const;
+    bool get(quint32 column, std::vector<QVariant>& values, const RawConverter& conv) const;
+    bool get(quint32 column, std::vector<QVariant>& values) const;
+    StringView stringView(quint32 row, quint32 column) const;
+    const double *coordinateData(quint32 row, quint32 column, quint32& count) const;
+    const qint32 *intData(quint32 column) const;
+    const double *doubleData(quint32 column, quint32& stride) const;
+    CoordinateView coordinates(quint32 row, quint32 column) const;
     quint32 index(const QString& colname) const;
     quint32 rows() const;
     quint32 columns() const;
     QString columnName(int index);
     void addStoreDefinition(const DataDefinition &def);
     void storeRecord(std::ofstream &output_file, const std::vector<QVariant> &rec, int skip=iUNDEF);
-    bool openOutput(const QString &basename, std::ofstream &output_file);
+    void columnBatch(quint32 column, const std::vector<QVariant> &values, quint32 first, quint32 count, ColumnBatch& batch) const;
+    void storeColumns(std::ofstream &output_file, const std::vector<ColumnBatch> &columns, int skip=iUNDEF);
+    void encodeColumns(const std::vector<ColumnBatch> &columns, int skip, std::vector<char>& buffer, std::vector<quint64>& ends) const;
+    QString storeLayout(int skip=iUNDEF) const;
+    bool openOutput(const QString &basename, std::ofstream &output_file, bool append=false);
+    static QString outputPath(const QString &basename);
 private:
     struct ColumnInfo{
-        bool _isRaw;
-        quint32 _offset;
+        bool _selected; // only selected columns are decoded
+        quint32 _width; // bytes per cell in the data file; 0 for variable length columns
         IlwisTypes _type;
         QString _name;
+        QString _range; // Range of the column in the ODF; tells how raw values convert to reals
         RawConverter _conv;
     };
+    // decoded cells of one column; only the member matching the column type is used. The getters go through
+    // the pointers, which refer either to the vectors and the arena or to the mapped cache file
+    struct ColumnData{
+        ColumnData() : _base(0), _encoded(false), _intValues(0), _doubleValues(0), _offsetValues(0), _payload(0) {}
+        std::vector<qint32> _ints; // values, or dictionary codes for encoded string columns
+        std::vector<double> _doubles; // reals and fixed coordinates (2 or 3 values per row)
+        std::vector<quint64> _offsets; // rows + 1 byte offsets, relative to _base, for variable length columns
+        quint64 _base; // start of the column's payload in the arena
+        bool _encoded;
+        std::vector<QByteArray> _dictionary; // distinct values of an encoded string column
+        std::vector<QString> _strings; // the same values, converted once
+        const qint32 *_intValues;
+        const double *_doubleValues;
+        const quint64 *_offsetValues;
+        const char *_payload;
+    };
     quint32 _rows;
     quint32 _columns;
-    quint32 _recordSize;
-    char * _records;
     QVector<ColumnInfo> _columnInfo;
+    std::vector<ColumnData> _columnData;
+    std::vector<double> _arena; // payload of all string and coordinate cells; doubles for the alignment
+    quint32 _completeRows; // rows that are entirely present in the data file
+    qint64 _rowWidth; // bytes per row when all columns have a fixed width, else 0
+    std::vector<quint64> _rowStarts; // only for variable width rows: file offset of each complete row, plus the end of the last one
+    QStringList _envelopeColumns; // extents of a row (minimum and maximum coordinate) for the envelope filter
+    double _envelope[4]; // minx, miny, maxx, maxy
+    quint32 _filterMin;
+    quint32 _filterMax;
+    std::vector<char> _selection; // rows selected before loading; empty for all rows
+    std::vector<char> _rowFilter; // rows to decode, the others stay undefined; empty for all rows
     bool _loaded;
+    QScopedPointer<ArrowFile> _cache;
+
+    // how the values of an output column are written
+    enum StoreKind{ skNONE, skITEM, skLONG, skREAL, skRAW, skSTRING, skCOORD };
+    // a batch of one output column, encoded; _ends holds the end of each cell in _bytes
+    struct EncodedColumn{
+        std::vector<char> _bytes;
+        std::vector<quint64> _ends;
+    };
 
     void getColumnInfo(const ODF &odf, const QString &prfix="");
-    void readData(char *memblock);
-    QString *readString(char *mem);
-    char *readCoordList(char *mem, long &count);
-    char *moveTo(int row, const ColumnInfo &fld) const;
+    static const quint32 ROWCHUNK = 65536;
+    static const quint32 MINDICTIONARY = 1024;
+
+    bool readData(const char *memblock, qint64 size, bool mapped, const QFileInfo &datafile);
+    qint64 fixedRowWidth() const;
+    qint64 rowStart(quint32 row) const { return _rowWidth > 0 ? 128 + row * _rowWidth : _rowStarts[row]; }
+    void buildRowIndex(const char *memblock, qint64 size);
+    bool readRowIndex(const QFileInfo &datafile, qint64 size);
+    void writeRowIndex(const QFileInfo &datafile) const;
+    static QString rowIndexFile(const QFileInfo &datafile);
+    void measure(const char *memblock, quint32 completeRows);
+    void decode(const char *memblock, quint32 first, quint32 last, bool mapped);
+    bool encodeStrings(quint32 column);
+    void compactArena();
+    void setViews();
+    bool readCache(const QFileInfo &datafile);
+    void writeCache(const QFileInfo &datafile) const;
+    static QString cacheFile(const QFileInfo &datafile);
+    static StoreKind storeKind(const ColumnInfo& info);
+    void encodeColumn(quint32 column, const ColumnBatch &batch, EncodedColumn& encoded) const;
+    void releasePages(const char *memblock, qint64 from, qint64 to) const;
     bool check(quint32 row, quint32 col) const;
     std::mutex _mutex;
 
@@ -296,7 +296,10 @@ TableConnector *CoverageConnector::createTableConnector(ITable& attTable, Covera
     attTable->setName(dataFile);
     QString dir = context()->workingCatalog()->location().toLocalFile();
     QString filename = dir + "/" + dataFile + ".tbt";
-    TableConnector *conn = new TableConnector(Resource(QUrl::fromLocalFile(filename), itTABLE), false);
+    Resource resource(QUrl::fromLocalFile(filename), itTABLE);
+    if ( appendRequested()) // the attribute table follows its coverage
+        resource.addProperty("append", true);
+    TableConnector *conn = new TableConnector(resource, false);
     //attribute domains are comming from ilwis4 always uniqueid and based on the map
     conn->attributeDomain(attDom);
 
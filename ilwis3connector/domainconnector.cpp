@@ -72,7 +72,7 @@ bool DomainConnector::handleItemDomains(IlwisObject* data) {
         return handleIdDomain(data);
     }
     Ilwis3::BinaryIlwis3Table tbl ;
-    tbl.load(_odf);
+    tbl.load(_odf, "", {"Name", "Code"});
     quint32 indexName = tbl.index("Name");
     if (indexName == iUNDEF) { // no name column in the table ?
         kernel()->issues()->log(TR(ERR_COLUMN_MISSING_2).arg("Name",_odf->fileinfo().baseName()));
@@ -1,6 +1,7 @@
 #include <QSqlQuery>
 #include <QSqlError>
 #include <fstream>
+#include <thread>
 #include <iterator>
 
 #include "kernel.h"
@@ -25,13 +26,17 @@
 #include "featurecoverage.h"
 #include "featureiterator.h"
 #include "containerstatistics.h"
+#include "mastercatalog.h"
 #include "rawconverter.h"
 #include "ilwisobjectconnector.h"
 #include "ilwis3connector.h"
 #include "binaryilwis3table.h"
+#include "tableconnector.h"
 #include "coordinatedomain.h"
 #include "coverageconnector.h"
 #include "featureconnector.h"
+#include "featureindex.h"
+#include "sidecarfile.h"
 
 using namespace Ilwis;
 using namespace Ilwis3;
@@ -40,6 +45,61 @@ struct XYZ {
     double x,y,z;
 };
 
+static void appendBytes(std::vector<char>& bytes, const void *data, quint32 size) {
+    bytes.insert(bytes.end(), (const char *)data, (const char *)data + size);
+}
+
+static void appendCoords(std::vector<char>& bytes, const std::vector<Coordinate2d>& coords) {
+    // same layout as writeCoords: the count followed by xyz triples
+    quint32 crdCount = coords.size();
+    appendBytes(bytes, &crdCount, 4);
+    for(const Coordinate2d& crd : coords) {
+        double xyz[3] = {crd.x(), crd.y(), 0};
+        appendBytes(bytes, xyz, sizeof(xyz));
+    }
+}
+
+static bool overlaps(const Box2D<double>& window, double minx, double miny, double maxx, double maxy) {
+    return minx <= window.max_corner().x() && maxx >= window.min_corner().x() &&
+           miny <= window.max_corner().y() && maxy >= window.min_corner().y();
+}
+
+static bool topologyRow(qint32 link, quint32 topologies, quint32& row) {
+    // links and TopStart are signed 1-based topology numbers, the sign gives the direction; 0 and iUNDEF link nothing
+    qint64 number = std::abs((qint64)link);
+    if ( link == iUNDEF || number == 0 || number > topologies)
+        return false;
+    row = number - 1;
+    return true;
+}
+
+template<typename Iter> static bool envelope(Iter begin, const Iter& end, double box[4]) {
+    // minx, miny, maxx, maxy of the coordinates
+    if ( begin == end)
+        return false;
+    box[0] = box[2] = (*begin).x();
+    box[1] = box[3] = (*begin).y();
+    for(; begin != end; ++begin) {
+        box[0] = std::min(box[0], (*begin).x());
+        box[1] = std::min(box[1], (*begin).y());
+        box[2] = std::max(box[2], (*begin).x());
+        box[3] = std::max(box[3], (*begin).y());
+    }
+    return true;
+}
+
+template<typename Iter> static bool overlaps(const Box2D<double>& window, Iter begin, const Iter& end) {
+    double box[4];
+    return envelope(begin, end, box) && overlaps(window, box[0], box[1], box[2], box[3]);
+}
+
+template<typename Iter> void FeatureConnector::addEnvelope(quint32 item, Iter begin, const Iter& end)
+{
+    double box[4];
+    if ( envelope(begin, end, box))
+        addEnvelope(item, box);
+}
+
 ConnectorInterface *FeatureConnector::create(const Resource &resource, bool load) {
     return new FeatureConnector(resource, load);
 
@@ -54,132 +114,212 @@ void FeatureConnector::calcStatics(const IlwisObject *obj, NumericStatistics::Pr
 {
 }
 
-FeatureConnector::FeatureConnector(const Resource &resource, bool load) : CoverageConnector(resource, load)
+FeatureConnector::FeatureConnector(const Resource &resource, bool load) : CoverageConnector(resource, load), _collectEnvelopes(false)
 {
 }
 
-bool FeatureConnector::loadBinaryPolygons30(FeatureCoverage *fcoverage, ITable& tbl) {
+bool FeatureConnector::loadBinaryPolygons30(FeatureCoverage *fcoverage, ITable& tbl, QString ringCache) {
     BinaryIlwis3Table polTable;
-    if ( !polTable.load(_odf)) {
+    if ( !polTable.load(_odf, "", {"PolygonValue", "TopStart", "Area"})) {
         return ERROR1(ERR_COULD_NOT_OPEN_READING_1,_odf->fileinfo().fileName())    ;
     }
 
     BinaryIlwis3Table topTable;
-    if ( !topTable.load(_odf,"top")) {
+    if ( !topTable.load(_odf,"top", {"Coords", "ForwardLink", "BackwardLink"})) {
         return ERROR1(ERR_COULD_NOT_OPEN_READING_1,_odf->fileinfo().fileName())    ;
     }
+    Topology topology;
+    topology._table = &topTable;
+    topology._colCoords = topTable.index("Coords");
+    topology._forward = topTable.intData(topTable.index("ForwardLink"));
+    topology._backward = topTable.intData(topTable.index("BackwardLink"));
+    if ( topology._colCoords == iUNDEF || !topology._forward || !topology._backward)
+        return ERROR2(ERR_INVALID_PROPERTY_FOR_2,"topology",_odf->fileinfo().fileName());
 
     qint32 colValue = polTable.index("PolygonValue");
     qint32 colTopStart = polTable.index("TopStart");
     qint32 colArea = polTable.index("Area");
-    int nrPolygons = polTable.rows();
+    quint32 nrPolygons = polTable.rows();
     bool isNumeric = _odf->value("BaseMap","Range") != sUNDEF;
+    Box2D<double> window;
+    bool filtered = queryEnvelope(window);
+    if ( filtered) // a partial result is not cached
+        ringCache.clear();
+
+    // the polygons of a block are assembled by several threads and then added in their original order, so the
+    // feature ids do not depend on the scheduling; the blocks keep the number of pending polygons limited
+    const quint32 BLOCK = 65536;
+    const quint32 MINPERTHREAD = 1024;
+    QScopedPointer<SidecarFile> cache;
+    if ( !ringCache.isEmpty()) { // polygons that could not be assembled are cached with an empty outer ring
+        cache.reset(ringCacheFile(ringCache));
+        if ( !cache->create() || !cache->write(&nrPolygons, 4))
+            cache.reset();
+    }
+    std::vector<char> cached;
+    quint32 loaded = 0;
+    std::vector<Polygon> polygons;
+    std::vector<char> assembled;
+    for(quint32 first = 0; first < nrPolygons; first += BLOCK) {
+        quint32 last = std::min(nrPolygons, first + BLOCK);
+        polygons.assign(last - first, Polygon());
+        assembled.assign(last - first, 0);
+        auto assemble = [&](quint32 begin, quint32 end) {
+            double v;
+            for(quint32 i = begin; i < end; ++i) {
+                if ( !isCandidate(i))
+                    continue;
+                polTable.get(i,colArea, v);
+                if ( v < 0)
+                    continue;
+                polTable.get(i,colTopStart,v);
+                qint32 index = v;
+                std::vector<std::vector<Coordinate2d>> rings;
+                if (!getRings(index, topology, rings) || rings.size() == 0)
+                    continue;
+                if ( filtered && !overlaps(window, rings[0].begin(), rings[0].end()))
+                    continue;
+                Polygon& polygon = polygons[i - first];
+                polygon.outer().resize(rings[0].size());
+                std::copy(rings[0].begin(), rings[0].end(), polygon.outer().begin());
+                polygon.inners().resize(rings.size() - 1);
+                for(quint32 j = 1; j < rings.size(); ++j) {
+                    polygon.inners()[j-1].resize(rings[j].size());
+                    std::copy(rings[j].begin(), rings[j].end(), polygon.inners()[j-1].begin());
+                }
+                assembled[i - first] = 1;
+            }
+        };
+        forBands(first, last, MINPERTHREAD, assemble);
 
-    double v;
-    for(int i = 0; i < nrPolygons; ++i) {
-        polTable.get(i,colArea, v);
-        if ( v < 0)
-            continue;
-        polTable.get(i,colTopStart,v);
-        qint32 index = v;
-        std::vector<std::vector<Coordinate2d>> rings;
-        if (getRings(index, topTable, polTable, rings)) {
-            if ( rings.size() == 0)
+        double v;
+        cached.clear();
+        for(quint32 i = first; i < last; ++i) {
+            if ( !assembled[i - first]) {
+                if ( cache) {
+                    quint32 none = 0;
+                    v = 0;
+                    appendBytes(cached, &none, 4);
+                    appendBytes(cached, &v, 8);
+                    appendBytes(cached, &none, 4);
+                }
                 continue;
-            Polygon polygon;
-            polygon.outer().resize(rings[0].size());
-            std::copy(rings[0].begin(), rings[0].end(), polygon.outer().begin());
-            for(int j = 1; j < rings.size(); ++j) {
-                polygon.inners()[j-1].resize(rings[j].size());
-                std::copy(rings[j].begin(), rings[j].end(), polygon.inners()[j-1].begin());
             }
+            const Polygon& polygon = polygons[i - first];
+            quint32 record = filtered ? loaded : i;
+            ++loaded;
             polTable.get(i, colValue, v);
+            if ( cache) {
+                appendCoords(cached, polygon.outer());
+                appendBytes(cached, &v, 8);
+                quint32 holeCount = polygon.inners().size();
+                appendBytes(cached, &holeCount, 4);
+                for(const std::vector<Coordinate2d>& coords : polygon.inners())
+                    appendCoords(cached, coords);
+            }
+            if ( _collectEnvelopes)
+                addEnvelope(record, polygon.outer().begin(), polygon.outer().end());
             if ( isNumeric) {
-                tbl->cell(COVERAGEKEYCOLUMN, i, QVariant(i));
-                tbl->cell(FEATUREVALUECOLUMN, i, QVariant(v));
+                tbl->cell(COVERAGEKEYCOLUMN, record, QVariant(i));
+                tbl->cell(FEATUREVALUECOLUMN, record, QVariant(v));
                 fcoverage->newFeature({polygon});
             } else {
                 quint32 itemId = v;
-                tbl->cell(COVERAGEKEYCOLUMN, i, QVariant(itemId));
+                tbl->cell(COVERAGEKEYCOLUMN, record, QVariant(itemId));
                 SPFeatureI feature = fcoverage->newFeature({polygon});
-                tbl->cell(FEATUREIDCOLUMN, i, QVariant(feature->featureid()));
+                tbl->cell(FEATUREIDCOLUMN, record, QVariant(feature->featureid()));
             }
         }
+        if ( cache && !cache->write(cached.data(), cached.size()))
+            cache.reset();
     }
+    if ( cache) // failing to write it is harmless
+        cache->commit();
+    if ( filtered)
+        setFilteredCount(fcoverage, tbl, loaded);
     return true;
 }
 
-bool FeatureConnector::getRings(qint32 startIndex, const BinaryIlwis3Table& topTable, const BinaryIlwis3Table& polTable, std::vector<vector<Coordinate2d>>& rings ){
-    qint32 row = startIndex;
-    qint32 colCoords = topTable.index("Coords");
-    qint32 colForward = topTable.index("ForwardLink");
-    qint32 colBackward = topTable.index("BackwardLink");
-    std::vector<Coordinate> ring;
-    bool forward = isForwardStartDirection(topTable,colForward, colBackward, colCoords, row);
-    do{
-        std::vector<Coordinate> coords;
-        topTable.get(row,colCoords,coords);
-        if( coords.size() == 0 ||coords.back() == coords.front()){
-            ring.resize(coords.size());
-            std::copy(coords.begin(), coords.end(), ring.begin());
-        } else if ( coords.back() == ring.back()) {
-            ring.resize(coords.size());
-            std::reverse_copy(coords.begin(), coords.end(), ring.begin());
-        } else if ( ring.front() == coords.front()) {
-            ring.resize(coords.size());
-            std::reverse_copy(coords.begin(), coords.end(), ring.begin());
-        } else if ( ring.front() == coords.back()) {
-            ring.resize(coords.size());
-            std::copy(coords.begin(), coords.end(), ring.begin());
-        }
+QFileInfo FeatureConnector::tableDataFile(const QString& prefix) const {
+    QString datafile = _odf->value(prefix + "TableStore", "Data");
+    return QFileInfo(context()->workingCatalog()->filesystemLocation().toLocalFile() + "/" + datafile);
+}
 
-        if ( ring.front() == ring.back() && ring.size() > 3) {
-            std::vector<Coordinate2d> ring2d;
-            Coordinate crdOld;
-            for(const Coordinate& crd : ring) {
-                if ( crd == crdOld)  // remove duplicates
-                    continue;
-                ring2d.push_back(crd);
-                crdOld = crd;
+SidecarFile *FeatureConnector::ringCacheFile(const QString& cacheFile) const {
+    // the rings only stay valid as long as the topology and polygon tables do not change
+    return new SidecarFile(cacheFile, "RNG2", {tableDataFile("top:"), tableDataFile("")});
+}
+
+bool FeatureConnector::loadRingCache(FeatureCoverage *fcoverage, ITable& tbl, const QString& cacheFile) {
+    QScopedPointer<SidecarFile> cache(ringCacheFile(cacheFile));
+    qint64 size;
+    const char *data = cache->map(size);
+    quint32 nrPolygons = fcoverage->featureCount(itPOLYGON);
+    // a stale or damaged cache is expected now and then; the caller rebuilds it, so it is not reported
+    std::vector<qint64> starts;
+    if ( !data || size < 4 || memcmp(data, &nrPolygons, 4) != 0 || !polygonStarts37(data + 4, size - 4, nrPolygons, starts))
+        return false;
+    return readPolygons37(data + 4, starts, fcoverage, tbl);
+}
+
+bool FeatureConnector::getRings(qint32 startIndex, const Topology& topology, std::vector<vector<Coordinate2d>>& rings ){
+    quint32 topologies = topology._table->rows();
+    quint32 startRow, row;
+    if ( !topologyRow(startIndex, topologies, startRow))
+        return false;
+    row = startRow;
+    qint32 link = startIndex;
+    std::vector<Coordinate2d> ring;
+    bool forward = isForwardStartDirection(topology, startIndex);
+    // a polygon visits each of its topologies once; more steps than topologies means the links are corrupt
+    for(quint32 steps = 0; steps <= topologies; ++steps) {
+        CoordinateView coords = topology._table->coordinates(row, topology._colCoords);
+        quint32 n = coords.size();
+        if ( n > 0) {
+            // the topology is added in the direction in which it connects to the ring so far
+            bool reversed = ring.empty() ? !forward : !(coords.front() == ring.back()) && coords.back() == ring.back();
+            for(quint32 i = 0; i < n; ++i) {
+                Coordinate2d crd = coords[reversed ? n - 1 - i : i];
+                if ( ring.empty() || !(crd == ring.back())) // shared end points and duplicates only once
+                    ring.push_back(crd);
             }
-            rings.push_back(ring2d);
-            coords.clear();
+        }
+        if ( ring.size() > 3 && ring.front() == ring.back()) {
+            rings.push_back(ring);
             ring.clear();
         }
-        qint32 oldIndex = row;
-        double v;
-        if ( forward)
-            topTable.get(abs(row),colForward,v);
-        else
-            topTable.get(abs(row), colBackward, v);\
-        row = v;
-        if ( oldIndex == row && row != startIndex) // this would indicate infintite loop. corrupt data
+        qint32 next = forward ? topology._forward[row] : topology._backward[row];
+        if ( next == link && link != startIndex) // this would indicate infintite loop. corrupt data
+            return false;
+        if ( next == iUNDEF || next == 0)
+            return true;
+        if ( !topologyRow(next, topologies, row))
             return false;
-        forward = row > 0;
-    } while(abs(row) != abs(startIndex) && row != iUNDEF);
+        if ( row == startRow)
+            return true;
+        link = next;
+        forward = link > 0;
+    }
 
-    return true;
+    return false;
 }
 
-bool FeatureConnector::isForwardStartDirection(const BinaryIlwis3Table& topTable, qint32 colForward, qint32 colBackward, qint32 colCoords, long index) {
-    qint32 fwl, bwl;
-    double v;
-    topTable.get(abs(index),colForward, v );
-    fwl = v;
-    if ( fwl != iUNDEF)
-        --fwl; // due to being raw values
-    topTable.get(abs(index),colBackward, v );
-    bwl = v;
-    if ( bwl != iUNDEF)
-        --bwl;
+bool FeatureConnector::isForwardStartDirection(const Topology& topology, qint32 index) {
+    quint32 topologies = topology._table->rows();
+    quint32 row, forwardRow;
+    if ( !topologyRow(index, topologies, row))
+        return false;
+    qint32 fwl = topology._forward[row];
+    qint32 bwl = topology._backward[row];
 
-    if ( abs(fwl) == abs(bwl)	)
+    if ( std::abs((qint64)fwl) == std::abs((qint64)bwl))
         return true;
-    if ( index < 0)
+    if ( index < 0 || !topologyRow(fwl, topologies, forwardRow))
+        return false;
+    CoordinateView startLine = topology._table->coordinates(row, topology._colCoords);
+    CoordinateView forwardLine = topology._table->coordinates(forwardRow, topology._colCoords);
+    if ( startLine.empty() || forwardLine.empty())
         return false;
-    std::vector<Coordinate2d> startLine, forwardLine;
-    topTable.get(abs(index), colCoords,startLine);
-    topTable.get(abs(fwl), colCoords, forwardLine);
 
     bool forward = false;
     if ( fwl > 0)
@@ -205,58 +345,166 @@ bool FeatureConnector::loadBinaryPolygons37(FeatureCoverage *fcoverage, ITable&
         kernel()->issues()->log(TR(ERR_COULD_NOT_OPEN_READING_1).arg(file.fileName()));
         return false;
     }
-    QDataStream stream(&file);
-    int nrPolygons = fcoverage->featureCount(itPOLYGON);
-    SPAttributeRecord record( new AttributeRecord(tbl,FEATUREIDCOLUMN));
-    bool isNumeric = _odf->value("BaseMap","Range") != sUNDEF;
-
-    for(int j=0; j < nrPolygons; ++j) {
-        Polygon pol;
-        readRing(stream, pol.outer());
-        double value;
-        quint32 numberOfHoles;
-        stream.readRawData((char *)&value, 8);
-        stream.readRawData((char *)&numberOfHoles, 4);
-        pol.inners().resize(numberOfHoles);
-        for(quint32 i=0; i< numberOfHoles;++i)
-            readRing(stream, pol.inners()[i]);
-        if ( isNumeric) {
-            tbl->cell(COVERAGEKEYCOLUMN, j, QVariant(j));
-            tbl->cell(FEATUREVALUECOLUMN, j, QVariant(value));
-            SPFeatureI feature = fcoverage->newFeature({pol});
-            tbl->cell(FEATUREIDCOLUMN, j, QVariant(feature->featureid()));
-        } else {
-            quint32 itemId = value;
-            tbl->cell(COVERAGEKEYCOLUMN, j, QVariant(itemId));
-            SPFeatureI feature = fcoverage->newFeature({pol});
-            tbl->cell(FEATUREIDCOLUMN, j, QVariant(feature->featureid()));
-        }
-
+    // decoded straight from a mapping of the file; only when that fails it is read in memory
+    qint64 size = file.size();
+    bool ok;
+    std::vector<qint64> starts;
+    quint32 nrPolygons = fcoverage->featureCount(itPOLYGON);
+    uchar *mapped = file.map(0, size);
+    if ( mapped) {
+        ok = polygonStarts37((const char *)mapped, size, nrPolygons, starts) && readPolygons37((const char *)mapped, starts, fcoverage, tbl);
+        file.unmap(mapped);
+    } else {
+        QByteArray data = file.readAll();
+        ok = polygonStarts37(data.constData(), data.size(), nrPolygons, starts) && readPolygons37(data.constData(), starts, fcoverage, tbl);
     }
     file.close();
+    if ( !ok)
+        return ERROR1(ERR_COULD_NOT_OPEN_READING_1,"data file");
 
-    return true;
+    return ok;
 }
 
-bool FeatureConnector::readRing(QDataStream& stream, std::vector<Coordinate2d> &ring ) {
-    quint32 numberOfCoords;
+qint64 FeatureConnector::scanPolygon37(const char *data, qint64 size, qint64 pos) {
+    // end of the polygon that starts at pos, -1 when it does not fit in the data; only the counts are read
+    auto skipRing = [&](qint64 p) -> qint64 {
+        if ( p < 0 || p + 4 > size)
+            return -1;
+        quint32 count;
+        memcpy(&count, data + p, 4);
+        qint64 end = p + 4 + (qint64)count * sizeof(XYZ);
+        return end > size ? -1 : end;
+    };
+    pos = skipRing(pos);
+    if ( pos < 0 || pos + 12 > size)
+        return -1;
+    quint32 numberOfHoles;
+    memcpy(&numberOfHoles, data + pos + 8, 4);
+    pos += 12;
+    for(quint32 i = 0; i < numberOfHoles && pos >= 0; ++i)
+        pos = skipRing(pos);
+    return pos;
+}
 
-    if (stream.readRawData((char *)&numberOfCoords, 4) <= 0)
-        return ERROR1(ERR_COULD_NOT_OPEN_READING_1,"data file");
-    vector<XYZ> pnts(numberOfCoords);
-    stream.readRawData((char *)&pnts[0],numberOfCoords*3*8);
+const char *FeatureConnector::readRing(const char *p, std::vector<Coordinate2d> &ring ) {
+    quint32 numberOfCoords;
+    memcpy(&numberOfCoords, p, 4);
+    p += 4;
     ring.resize(numberOfCoords);
-    for(quint32 i=0; i < numberOfCoords; ++i) {
-        ring[i] = Coordinate2d(pnts[i].x, pnts[i].y);
+    for(quint32 i=0; i < numberOfCoords; ++i, p += sizeof(XYZ)) { // x and y of each XYZ, z is skipped
+        double xy[2];
+        memcpy(xy, p, 16);
+        ring[i] = Coordinate2d(xy[0], xy[1]);
     }
+    return p;
+}
 
-   return true;
+bool FeatureConnector::polygonStarts37(const char *data, qint64 size, quint32 nrPolygons, std::vector<qint64>& starts) {
+    // a quick pass over the counts finds where each polygon starts, so they can be decoded independently
+    starts.assign(1, 0);
+    starts.reserve(nrPolygons + 1);
+    for(quint32 j=0; j < nrPolygons; ++j) {
+        qint64 end = scanPolygon37(data, size, starts.back());
+        if ( end < 0)
+            return false;
+        starts.push_back(end);
+    }
+    return true;
+}
+
+bool FeatureConnector::readPolygons37(const char *data, const std::vector<qint64>& starts, FeatureCoverage *fcoverage, ITable& tbl) {
+    quint32 nrPolygons = starts.size() - 1;
+    bool isNumeric = _odf->value("BaseMap","Range") != sUNDEF;
+    Box2D<double> window;
+    bool filtered = queryEnvelope(window);
+    // envelope of the outer ring straight from the data, before anything is decoded
+    auto overlapsRing = [&](const char *p) -> bool {
+        quint32 count;
+        memcpy(&count, p, 4);
+        if ( count == 0)
+            return false;
+        double xyz[3];
+        memcpy(xyz, p + 4, 24);
+        double minx = xyz[0], maxx = minx, miny = xyz[1], maxy = miny;
+        for(quint32 i = 1; i < count; ++i) {
+            memcpy(xyz, p + 4 + i * sizeof(XYZ), 24);
+            minx = std::min(minx, xyz[0]);
+            maxx = std::max(maxx, xyz[0]);
+            miny = std::min(miny, xyz[1]);
+            maxy = std::max(maxy, xyz[1]);
+        }
+        return overlaps(window, minx, miny, maxx, maxy);
+    };
+
+    // decoded in parallel per block, added in order
+    const quint32 BLOCK = 65536;
+    const quint32 MINPERTHREAD = 1024;
+    std::vector<Polygon> polygons;
+    std::vector<double> values;
+    std::vector<char> selected;
+    quint32 loaded = 0;
+    for(quint32 first = 0; first < nrPolygons; first += BLOCK) {
+        quint32 last = std::min(nrPolygons, first + BLOCK);
+        polygons.assign(last - first, Polygon());
+        values.resize(last - first);
+        selected.assign(last - first, 1);
+        forBands(first, last, MINPERTHREAD, [&](quint32 begin, quint32 end) {
+            for(quint32 j = begin; j < end; ++j) {
+                Polygon& pol = polygons[j - first];
+                if ( filtered && (!isCandidate(j) || !overlapsRing(data + starts[j]))) {
+                    selected[j - first] = 0;
+                    continue;
+                }
+                const char *p = readRing(data + starts[j], pol.outer());
+                quint32 numberOfHoles;
+                memcpy(&values[j - first], p, 8);
+                memcpy(&numberOfHoles, p + 8, 4);
+                p += 12;
+                pol.inners().resize(numberOfHoles);
+                for(quint32 i=0; i< numberOfHoles;++i)
+                    p = readRing(p, pol.inners()[i]);
+            }
+        });
+
+        for(quint32 j = first; j < last; ++j) {
+            const Polygon& pol = polygons[j - first];
+            double value = values[j - first];
+            if ( !selected[j - first]) // filtered out; an empty outer ring is still a feature, so features and records line up
+                continue;
+            quint32 record = filtered ? loaded : j;
+            ++loaded;
+            if ( _collectEnvelopes)
+                addEnvelope(record, pol.outer().begin(), pol.outer().end());
+            if ( isNumeric) {
+                tbl->cell(COVERAGEKEYCOLUMN, record, QVariant(j));
+                tbl->cell(FEATUREVALUECOLUMN, record, QVariant(value));
+                SPFeatureI feature = fcoverage->newFeature({pol});
+                tbl->cell(FEATUREIDCOLUMN, record, QVariant(feature->featureid()));
+            } else {
+                quint32 itemId = value;
+                tbl->cell(COVERAGEKEYCOLUMN, record, QVariant(itemId));
+                SPFeatureI feature = fcoverage->newFeature({pol});
+                tbl->cell(FEATUREIDCOLUMN, record, QVariant(feature->featureid()));
+            }
+        }
+    }
+    if ( filtered)
+        setFilteredCount(fcoverage, tbl, loaded);
+    return true;
 }
 
 bool FeatureConnector::loadBinaryPolygons(FeatureCoverage *fcoverage) {
     QString dataFile = _odf->value("PolygonMapStore","DataPol");
     ITable tbl = fcoverage->attributeTable();
     if ( dataFile == sUNDEF) {
+        // on request the assembled rings are kept in the 3.7 layout, so later loads skip the topology walk
+        QVariant cache = _resource["ringcache"];
+        if ( cache.isValid() && cache.toBool()) {
+            QString cacheFile = tableDataFile("top:").absoluteFilePath() + ".rng";
+            if ( loadRingCache(fcoverage, tbl, cacheFile))
+                return true;
+            return loadBinaryPolygons30(fcoverage, tbl, cacheFile);
+        }
         return loadBinaryPolygons30(fcoverage, tbl);
     } else {
         return loadBinaryPolygons37(fcoverage, tbl);
@@ -266,39 +514,71 @@ bool FeatureConnector::loadBinaryPolygons(FeatureCoverage *fcoverage) {
 
 bool FeatureConnector::loadBinarySegments(FeatureCoverage *fcoverage) {
     BinaryIlwis3Table mpsTable;
-    if ( !mpsTable.load(_odf)) {
+    Box2D<double> window;
+    bool filtered = queryEnvelope(window);
+    if ( filtered) { // the stored extents of the segments decide which coordinates are decoded at all
+        double envelope[4] = {window.min_corner().x(), window.min_corner().y(), window.max_corner().x(), window.max_corner().y()};
+        mpsTable.selectEnvelope("MinCoords", "MaxCoords", envelope);
+        mpsTable.selectRows(_candidates);
+    }
+    bool useExtents = filtered || _collectEnvelopes;
+    QStringList columns = {"Coords", "SegmentValue"};
+    if ( useExtents)
+        columns << "MinCoords" << "MaxCoords";
+    if ( !mpsTable.load(_odf, "", columns)) {
         return ERROR1(ERR_COULD_NOT_OPEN_READING_1,_odf->fileinfo().fileName())    ;
     }
     int colCoords = mpsTable.index("Coords");
     int colItemId = mpsTable.index("SegmentValue");
+    quint32 colMin = mpsTable.index("MinCoords");
+    quint32 colMax = mpsTable.index("MaxCoords");
+    bool hasExtents = useExtents && colMin != iUNDEF && colMax != iUNDEF;
     bool isNumeric = _odf->value("BaseMap","Range") != sUNDEF;
     ITable tbl = fcoverage->attributeTable();
 //    if ( isNumeric) // in other case nr of record already has been set as it is based on a real table
 //        tbl->setRows(mpsTable.rows());
 
     double value;
+    quint32 loaded = 0;
     for(quint32 i= 0; i < mpsTable.rows(); ++i) {
-        std::vector<Coordinate > coords;
-        mpsTable.get(i,colCoords,coords);
+        if ( !mpsTable.selected(i))
+            continue;
+        CoordinateView coords = mpsTable.coordinates(i,colCoords);
+        if ( filtered && !hasExtents && !overlaps(window, coords.begin(), coords.end())) // no stored extents
+            continue;
+        quint32 record = filtered ? loaded : i;
+        ++loaded;
+        if ( _collectEnvelopes) {
+            if ( hasExtents) {
+                Coordinate cmin, cmax;
+                mpsTable.get(i, colMin, cmin);
+                mpsTable.get(i, colMax, cmax);
+                double box[4] = {cmin.x(), cmin.y(), cmax.x(), cmax.y()};
+                addEnvelope(record, box);
+            } else
+                addEnvelope(record, coords.begin(), coords.end());
+        }
         Line2D<Coordinate2d > line;
         line.resize(coords.size());
         std::copy(coords.begin(), coords.end(), line.begin());
         mpsTable.get(i, colItemId,value);
         if ( isNumeric) {
-            tbl->cell(COVERAGEKEYCOLUMN, i, QVariant(i));
-            tbl->cell(FEATUREVALUECOLUMN, i, QVariant(value));
+            tbl->cell(COVERAGEKEYCOLUMN, record, QVariant(i));
+            tbl->cell(FEATUREVALUECOLUMN, record, QVariant(value));
             SPFeatureI feature = fcoverage->newFeature({line});
-            tbl->cell(FEATUREIDCOLUMN, i, QVariant(feature->featureid()));
+            tbl->cell(FEATUREIDCOLUMN, record, QVariant(feature->featureid()));
 
         } else {
             quint32 itemId = value;
-            tbl->cell(COVERAGEKEYCOLUMN, i, QVariant(itemId));
+            tbl->cell(COVERAGEKEYCOLUMN, record, QVariant(itemId));
             SPFeatureI feature = fcoverage->newFeature({line});
-            tbl->cell(FEATUREIDCOLUMN, i, QVariant(feature->featureid()));
+            tbl->cell(FEATUREIDCOLUMN, record, QVariant(feature->featureid()));
         }
 
 
     }
+    if ( filtered)
+        setFilteredCount(fcoverage, tbl, loaded);
     return true;
 
 
@@ -306,7 +586,7 @@ bool FeatureConnector::loadBinarySegments(FeatureCoverage *fcoverage) {
 
 bool FeatureConnector::loadBinaryPoints(FeatureCoverage *fcoverage) {
     BinaryIlwis3Table mppTable;
-    if ( !mppTable.load(_odf)) {
+    if ( !mppTable.load(_odf, "", {"x", "y", "Coordinate", "Name"})) {
         return ERROR1(ERR_COULD_NOT_OPEN_READING_1,_odf->fileinfo().fileName())    ;
     }
     // two cases; the old case; 2 columns for x and y. and the new case one column for coord
@@ -317,27 +597,80 @@ bool FeatureConnector::loadBinaryPoints(FeatureCoverage *fcoverage) {
 
     ITable tbl = fcoverage->attributeTable();
     bool newCase =  coordColumnX == iUNDEF;
-
-    for(quint32 i= 0; i < mppTable.rows(); ++i) {
-        Coordinate c;
-        double itemIdT;
-        if ( newCase) {
-            mppTable.get(i, coordColumn, c);
-        } else {
-            double x,y;
-            mppTable.get(i, coordColumnX, x);
-            mppTable.get(i, coordColumnY, y);
-            c = Coordinate(x,y);
+    Box2D<double> window;
+    bool filtered = queryEnvelope(window);
+
+    // coordinates and ids are used as arrays; columns not stored as expected fall back to the cell getters
+    quint32 rows = mppTable.rows();
+    quint32 stride = 0, strideX = 0, strideY = 0;
+    const double *coords = newCase ? mppTable.doubleData(coordColumn, stride) : 0;
+    const double *xs = newCase ? 0 : mppTable.doubleData(coordColumnX, strideX);
+    const double *ys = newCase ? 0 : mppTable.doubleData(coordColumnY, strideY);
+    const qint32 *names = mppTable.intData(colItemId);
+    std::vector<Coordinate> points(rows);
+    std::vector<quint32> itemIds(rows);
+    std::vector<char> loaded(rows, 0);
+    forBands(0, rows, 65536, [&](quint32 begin, quint32 end) {
+        for(quint32 i = begin; i < end; ++i) {
+            if ( !isCandidate(i))
+                continue;
+            Coordinate c;
+            if ( newCase) {
+                if ( coords)
+                    c = Coordinate(coords[i * stride], coords[i * stride + 1], stride == 3 ? coords[i * stride + 2] : rUNDEF);
+                else
+                    mppTable.get(i, coordColumn, c);
+            } else {
+                double x,y;
+                if ( xs && ys) {
+                    x = xs[i * strideX];
+                    y = ys[i * strideY];
+                } else {
+                    mppTable.get(i, coordColumnX, x);
+                    mppTable.get(i, coordColumnY, y);
+                }
+                c = Coordinate(x,y);
+            }
+            if ( filtered && !overlaps(window, c.x(), c.y(), c.x(), c.y()))
+                continue;
+            double itemIdT;
+            if ( names)
+                itemIdT = names[i];
+            else
+                mppTable.get(i, colItemId,itemIdT);
+            itemIds[i] = itemIdT;
+            points[i] = c;
+            loaded[i] = 1;
         }
-        mppTable.get(i, colItemId,itemIdT);
-        quint32 itemId = itemIdT;
-        tbl->cell(COVERAGEKEYCOLUMN, i, QVariant(itemId));
+    });
 
+    // the features are added in row order; the attribute columns are handed to the table in one go
+    std::vector<QVariant> keys = tbl->column(COVERAGEKEYCOLUMN);
+    std::vector<QVariant> featureIds = tbl->column(FEATUREIDCOLUMN);
+    keys.resize(std::max((quint32)keys.size(), rows));
+    featureIds.resize(std::max((quint32)featureIds.size(), rows));
+    quint32 count = 0;
+    for(quint32 i= 0; i < rows; ++i) {
+        if ( !loaded[i])
+            continue;
+        quint32 record = filtered ? count : i;
+        ++count;
+        const Coordinate& c = points[i];
+        if ( _collectEnvelopes) {
+            double box[4] = {c.x(), c.y(), c.x(), c.y()};
+            addEnvelope(record, box);
+        }
+        keys[record] = QVariant(itemIds[i]);
         SPFeatureI feature = fcoverage->newFeature({c});
-
-        tbl->cell(FEATUREIDCOLUMN, i, QVariant(feature->featureid()));
-
+        featureIds[record] = QVariant(feature->featureid());
+    }
+    if ( filtered) {
+        keys.resize(count);
+        featureIds.resize(count);
+        setFilteredCount(fcoverage, tbl, count);
     }
+    tbl->column(COVERAGEKEYCOLUMN, keys);
+    tbl->column(FEATUREIDCOLUMN, featureIds);
     return true;
 }
 
@@ -355,6 +688,34 @@ bool FeatureConnector::loadBinaryData(Ilwis::IlwisObject *obj) {
             return false;
         }
     }
+    // on request a spatial index over the features is kept next to the data file. A load restricted to an
+    // envelope only decodes the records the index returns; a full load builds the index when it is not valid
+    QVariant spatialIndex = _resource["spatialindex"];
+    Box2D<double> window;
+    bool filtered = queryEnvelope(window);
+    _candidates.clear();
+    _envelopes.clear();
+    _envelopeItems.clear();
+    _collectEnvelopes = false;
+    if ( spatialIndex.isValid() && spatialIndex.toBool()) {
+        std::vector<QFileInfo> sources = featureDataFiles();
+        QSharedPointer<FeatureIndex> index(new FeatureIndex());
+        bool valid = index->load(sources[0].absoluteFilePath() + ".str", sources);
+        if ( valid) {
+            Locker lock(_mutex);
+            _featureIndex = index;
+        }
+        if ( filtered && valid) {
+            FeatureIndex::Box box = {window.min_corner().x(), window.min_corner().y(), window.max_corner().x(), window.max_corner().y()};
+            _candidates.assign(fcoverage->featureCount(), 0);
+            for(quint32 item : index->query(box)) {
+                if ( item < _candidates.size())
+                    _candidates[item] = 1;
+            }
+        } else if ( !filtered && !valid)
+            _collectEnvelopes = true;
+    }
+
     bool ok = false;
      if (fcoverage->featureTypes() == itPOINT)
         ok = loadBinaryPoints(fcoverage);
@@ -362,21 +723,153 @@ bool FeatureConnector::loadBinaryData(Ilwis::IlwisObject *obj) {
         ok = loadBinarySegments(fcoverage);
     else if (fcoverage->featureTypes() == itPOLYGON)
         ok = loadBinaryPolygons(fcoverage);
+    if ( ok && _collectEnvelopes)
+        createSpatialIndex();
+    _collectEnvelopes = false;
+    std::vector<char>().swap(_candidates);
     if ( ok && extTable.isValid()) {
+        // an external table that has a key column of its own (one stored by this connector) is joined on it
+        // through the key index of its connector. In an ILWIS3 table on the domain of the map the record of
+        // key k is row k - 1. One pass over the keys and each record fetched once
         ITable attTbl = fcoverage->attributeTable();
-        quint32 keyIndex = attTbl->columnIndex(COVERAGEKEYCOLUMN);
-        for(quint32 rowExt=0; rowExt < extTable->records(); ++rowExt) {
+        std::vector<QVariant> keys = attTbl->column(COVERAGEKEYCOLUMN);
+        quint32 extRecords = extTable->records();
+        QScopedPointer<TableConnector> extConnector;
+        if ( extTable->columnIndex(COVERAGEKEYCOLUMN) != iUNDEF) {
+            QVariant persist = _resource["keyindex"];
+            extConnector.reset(new TableConnector(Resource(extTable->source().url(), itTABLE), true));
+            if ( !extConnector->buildKeyIndex(COVERAGEKEYCOLUMN, persist.isValid() && persist.toBool()))
+                extConnector.reset();
+        }
+        std::vector<std::vector<quint32>> matches(extRecords);
+        for(quint32 rowAtt = 0; rowAtt < keys.size(); ++rowAtt) {
+            bool isNumber;
+            double key = keys[rowAtt].toDouble(&isNumber);
+            if ( !isNumber || key != std::floor(key) || std::fabs(key) > 9007199254740992.0) // beyond 2^53 not an integer key
+                continue;
+            quint32 rowExt = iUNDEF;
+            if ( extConnector)
+                rowExt = extConnector->keyRow(COVERAGEKEYCOLUMN, key);
+            else if ( key >= 1 && key <= extRecords)
+                rowExt = key - 1;
+            if ( rowExt == iUNDEF || rowExt >= extRecords)
+                continue;
+            matches[rowExt].push_back(rowAtt);
+        }
+        for(quint32 rowExt = 0; rowExt < extRecords; ++rowExt) {
+            if ( matches[rowExt].empty())
+                continue;
             vector<QVariant> rec = extTable->record(rowExt);
-            for(quint32 rowAtt = 0; rowAtt < attTbl->records(); ++rowAtt ) {
-                if ( attTbl->cell(keyIndex, rowAtt) == rowExt + 1) {
-                    attTbl->record(rowAtt,rec);
-                }
-            }
+            for(quint32 rowAtt : matches[rowExt])
+                attTbl->record(rowAtt, rec);
         }
     }
     return ok;
 }
 
+void FeatureConnector::addEnvelope(quint32 item, const double box[4])
+{
+    _envelopes.insert(_envelopes.end(), box, box + 4);
+    _envelopeItems.push_back(item);
+}
+
+bool FeatureConnector::isCandidate(quint32 record) const
+{
+    return _candidates.empty() || (record < _candidates.size() && _candidates[record]);
+}
+
+void FeatureConnector::createSpatialIndex()
+{
+    std::vector<FeatureIndex::Box> boxes(_envelopeItems.size());
+    for(quint32 i = 0; i < boxes.size(); ++i) {
+        FeatureIndex::Box box = {_envelopes[i * 4], _envelopes[i * 4 + 1], _envelopes[i * 4 + 2], _envelopes[i * 4 + 3]};
+        boxes[i] = box;
+    }
+    std::vector<double>().swap(_envelopes);
+    QSharedPointer<FeatureIndex> index(new FeatureIndex());
+    index->build(boxes, _envelopeItems);
+    std::vector<quint32>().swap(_envelopeItems);
+    std::vector<QFileInfo> sources = featureDataFiles(); // failing to write it is harmless
+    index->store(sources[0].absoluteFilePath() + ".str", sources);
+    Locker lock(_mutex);
+    _featureIndex = index;
+}
+
+bool FeatureConnector::loadSpatialIndex()
+{
+    // read once from the sidecar and kept; a load of the map that reads or builds the index replaces it
+    if ( _featureIndex)
+        return true;
+    std::vector<QFileInfo> sources = featureDataFiles();
+    QSharedPointer<FeatureIndex> index(new FeatureIndex());
+    if ( !index->load(sources[0].absoluteFilePath() + ".str", sources))
+        return false;
+    _featureIndex = index;
+    return true;
+}
+
+std::vector<quint32> FeatureConnector::indexedFeatures(const Box2D<double> &envelope)
+{
+    // the records (numbered as in a full load) whose envelope overlaps the given one; empty without a valid index
+    Locker lock(_mutex);
+    if ( !loadSpatialIndex())
+        return std::vector<quint32>();
+    FeatureIndex::Box box = {envelope.min_corner().x(), envelope.min_corner().y(), envelope.max_corner().x(), envelope.max_corner().y()};
+    return _featureIndex->query(box);
+}
+
+quint32 FeatureConnector::nearestFeature(double x, double y)
+{
+    // the record whose envelope is closest to the point; iUNDEF without a valid index
+    Locker lock(_mutex);
+    if ( !loadSpatialIndex())
+        return iUNDEF;
+    return _featureIndex->nearest(x, y);
+}
+
+std::vector<QFileInfo> FeatureConnector::featureDataFiles() const
+{
+    // the files the geometry of the features comes from; the first one holds the coordinates. A 3.0 polygon
+    // is assembled from the topologies its polygon table row points to, so both tables count
+    QString dataPol = _odf->value("PolygonMapStore","DataPol");
+    if ( dataPol != sUNDEF)
+        return {QFileInfo(context()->workingCatalog()->filesystemLocation().toLocalFile() + "/" + dataPol)};
+    if ( _odf->value("top:TableStore", "Data") != sUNDEF)
+        return {tableDataFile("top:"), tableDataFile("")};
+    return {tableDataFile("")};
+}
+
+void FeatureConnector::setFilteredCount(FeatureCoverage *fcoverage, ITable &tbl, quint32 features) const
+{
+    // a load restricted to an envelope only has the features in it, at the first attribute rows
+    fcoverage->setFeatureCount(fcoverage->featureTypes(), features);
+    tbl->setRows(features);
+}
+
+bool FeatureConnector::queryEnvelope(Box2D<double> &envelope) const
+{
+    // the area of interest; only features overlapping it are loaded. Either a Box2D or "minx miny maxx maxy"
+    QVariant query = _resource["envelope"];
+    if ( !query.isValid())
+        return false;
+    if ( query.canConvert<Box2D<double>>()) {
+        envelope = query.value<Box2D<double>>();
+        return true;
+    }
+    QStringList parts = query.toString().split(" ", QString::SkipEmptyParts);
+    if ( parts.size() != 4)
+        return false;
+    double v[4];
+    for(int i = 0; i < 4; ++i) {
+        bool ok;
+        v[i] = parts[i].toDouble(&ok);
+        if (!ok)
+            return false;
+    }
+    envelope = Box2D<double>(Coordinate(v[0], v[1]), Coordinate(v[2], v[3]));
+    return true;
+}
+
 bool FeatureConnector::loadMetaData(Ilwis::IlwisObject *obj)
 {
     bool ok = CoverageConnector::loadMetaData(obj);
@@ -448,35 +941,77 @@ bool FeatureConnector::storeBinaryDataLine(FeatureCoverage *fcov, const QString&
     QFileInfo inf(baseName);
     QString dir = context()->workingCatalog()->location().toLocalFile();
     QString filename = dir + "/" + inf.baseName() + ".mps#";
-    output_file.open(filename.toLatin1(),ios_base::out | ios_base::binary | ios_base::trunc);
-    if ( !output_file.is_open())
-        return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
-    char header[128];
-    memset(header, 0, 128);
-    output_file.write(header,128);
 
     IFeatureCoverage cov;
     cov.set(fcov);
+    // one record of the segment table: extents, coordinates, deleted flag and raw value
+    auto encodeSegment = [](const Geometry& geom, quint32 raw, std::vector<char>& bytes) {
+        Line2D<Coordinate2d> line = geom.toType<Line2D<Coordinate2d>>();
+        const Coordinate2d& crdmin = geom.envelope().min_corner();
+        const Coordinate2d& crdmax = geom.envelope().max_corner();
+        double extents[4] = {crdmin.x(), crdmin.y(), crdmax.x(), crdmax.y()};
+        appendBytes(bytes, extents, sizeof(extents));
+        int noOfCoordsBytes = line.size() * 16;
+        appendBytes(bytes, &noOfCoordsBytes, 4);
+        for(const Coordinate2d& crd: line) {
+            double xy[2] = {crd.x(), crd.y()};
+            appendBytes(bytes, xy, sizeof(xy));
+        }
+        qint32 deleted=1;
+        appendBytes(bytes, &deleted, 4);
+        appendBytes(bytes, &raw, 4);
+    };
+
+    // in append mode only the segments behind those of the last binary store are written, see
+    // TableConnector::storeBinaryData; of the stored segments only the last one is compared
+    quint32 first = 0;
+    bool append = false;
+    if ( appendRequested() && storedRecords(itLINE, filename, fcov->featureCount(itLINE), "SegmentMapStore2", first)) {
+        append = first == 0;
+        quint32 raw = 1;
+        for(FeatureIterator iter(cov); iter != iter.end() && raw <= first; ++iter) {
+            SPFeatureI feature = *iter;
+            const Geometry& geom = feature->geometry();
+            for(int i=0; i < feature->trackSize() && raw <= first; ++i) {
+                if ( geom.ilwisType() != itLINE)
+                    continue;
+                if ( raw == first) {
+                    std::vector<char> bytes;
+                    encodeSegment(geom, raw, bytes);
+                    append = endsWith(filename, bytes.data(), bytes.size());
+                }
+                ++raw;
+            }
+        }
+        if ( !append)
+            first = 0;
+    }
+    if ( append) {
+        output_file.open(filename.toLatin1(),ios_base::out | ios_base::binary | ios_base::app);
+        if ( !output_file.is_open())
+            return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
+    } else {
+        output_file.open(filename.toLatin1(),ios_base::out | ios_base::binary | ios_base::trunc);
+        if ( !output_file.is_open())
+            return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
+        char header[128];
+        memset(header, 0, 128);
+        output_file.write(header,128);
+    }
+
     FeatureIterator iter(cov);
     quint32 raw = 1;
+    std::vector<char> bytes;
 
     for_each(iter, iter.end(), [&](SPFeatureI feature){
         const Geometry& geom = feature->geometry();
         for(int i=0; i < feature->trackSize(); ++i) {
-            if ( geom.ilwisType() == itLINE) {
-                Line2D<Coordinate2d> line = geom.toType<Line2D<Coordinate2d>>();
-                const Coordinate2d& crdmin = geom.envelope().min_corner();
-                const Coordinate2d& crdmax = geom.envelope().max_corner();
-                writeCoord(output_file, crdmin);
-                writeCoord(output_file, crdmax);
-                int noOfCoordsBytes = line.size() * 16;
-                output_file.write((char *)&noOfCoordsBytes, 4);
-                for(const Coordinate2d& crd: line) {
-                    writeCoord(output_file, crd);
-                }
-                long deleted=1;
-                output_file.write((char *)&deleted, 4);
-                output_file.write((char *)&raw, 4);
+            if ( geom.ilwisType() == itLINE && raw <= first) {
+                ++raw;
+            } else if ( geom.ilwisType() == itLINE) {
+                bytes.clear();
+                encodeSegment(geom, raw, bytes);
+                output_file.write(bytes.data(), bytes.size());
                 ++raw;
             }
         }
@@ -484,6 +1019,7 @@ bool FeatureConnector::storeBinaryDataLine(FeatureCoverage *fcov, const QString&
     });
 
     output_file.close();
+    setStoredData(itLINE, raw - 1, filename, "SegmentMapStore2");
 
     return true;
 }
@@ -641,6 +1177,7 @@ bool FeatureConnector::storeMetaData(FeatureCoverage *fcov, IlwisTypes type) {
         ok = storeMetaLine(fcov, dataFile);
     }
 
+    keepStoredData();
     _odf->store();
     return ok;
 }
@@ -8,6 +8,8 @@ class FeatureCoverage;
 namespace Ilwis3{
 
 class BinaryIlwis3Table;
+class SidecarFile;
+class FeatureIndex;
 
 class FeatureConnector : public CoverageConnector
 {
@@ -24,16 +26,41 @@ public:
     bool storeMetaPolygon(FeatureCoverage *fcov, const QString &dataFile);
     bool storeBinaryData(IlwisObject *obj);
 
+    std::vector<quint32> indexedFeatures(const Box2D<double>& envelope);
+    quint32 nearestFeature(double x, double y);
+
 private:
     bool loadBinaryPoints(FeatureCoverage *fcoverage);
     bool loadBinarySegments(FeatureCoverage *fcoverage);
     bool loadBinaryPolygons(FeatureCoverage *fcoverage);
-    bool loadBinaryPolygons30(FeatureCoverage *fcoverage, ITable &tbl);
+    bool loadBinaryPolygons30(FeatureCoverage *fcoverage, ITable &tbl, QString ringCache=QString());
     bool loadBinaryPolygons37(FeatureCoverage *fcoverage, ITable& tbl);
-    //bool readRing(QDataStream &stream,boost::geometry::model::ring<Coordinate2d>& ring);
-    bool readRing(QDataStream &stream,std::vector<Coordinate2d>& ring);
-    bool getRings(qint32 startIndex, const BinaryIlwis3Table &topTable, const BinaryIlwis3Table& polTable, std::vector<vector<Coordinate2d> > &rings);
-    bool isForwardStartDirection(const BinaryIlwis3Table &topTable, qint32 colForward, qint32 colBackward, qint32 colCoords, long index);
+    bool readPolygons37(const char *data, const std::vector<qint64>& starts, FeatureCoverage *fcoverage, ITable& tbl);
+    bool queryEnvelope(Box2D<double>& envelope) const;
+    void setFilteredCount(FeatureCoverage *fcoverage, ITable& tbl, quint32 features) const;
+    std::vector<QFileInfo> featureDataFiles() const;
+    void addEnvelope(quint32 item, const double box[4]);
+    template<typename Iter> void addEnvelope(quint32 item, Iter begin, const Iter& end);
+    bool isCandidate(quint32 record) const;
+    void createSpatialIndex();
+    bool loadSpatialIndex();
+    static qint64 scanPolygon37(const char *data, qint64 size, qint64 pos);
+    static bool polygonStarts37(const char *data, qint64 size, quint32 nrPolygons, std::vector<qint64>& starts);
+    static const char *readRing(const char *p, std::vector<Coordinate2d>& ring);
+    // the decoded topology table, shared read only by the threads assembling the polygons
+    struct Topology{
+        const BinaryIlwis3Table *_table;
+        quint32 _colCoords;
+        const qint32 *_forward;
+        const qint32 *_backward;
+    };
+    static bool getRings(qint32 startIndex, const Topology& topology, std::vector<vector<Coordinate2d> > &rings);
+    static bool isForwardStartDirection(const Topology& topology, qint32 index);
+
+    // the ring cache of a 3.0 polygon map holds the polygon count, followed by its polygons in the 3.7 layout
+    QFileInfo tableDataFile(const QString &prefix) const;
+    SidecarFile *ringCacheFile(const QString &cacheFile) const;
+    bool loadRingCache(FeatureCoverage *fcoverage, ITable& tbl, const QString &cacheFile);
 
     void writeCoords(std::ofstream &output_file, const std::vector<Coordinate2d>& coords, bool singleton=false);
     bool storeBinaryDataPolygon(Ilwis::FeatureCoverage *fcov, const QString &baseName);
@@ -45,6 +72,12 @@ private:
     void storeColumn(const QString &colName, const QString &domName, const QString &domInfo, const QString &storeType);
     QString type2Prefix(IlwisTypes tp);
 
+    bool _collectEnvelopes;
+    std::vector<double> _envelopes; // minx, miny, maxx, maxy of each loaded feature
+    std::vector<quint32> _envelopeItems; // the record of each of these features
+    std::vector<char> _candidates; // records the spatial index returned for the query envelope; empty for all
+    QSharedPointer<FeatureIndex> _featureIndex; // the spatial index the queries use, once it has been read or built
+
     void writeCoord(std::ofstream& output_file, const Coordinate2d& crd) {
         double x = crd.x();
         double y = crd.y();
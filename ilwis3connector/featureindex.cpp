@@ -0,0 +1,181 @@
+#include <QString>
+#include <QFile>
+#include <QFileInfo>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <queue>
+
+#include "kernel.h"
+#include "featureindex.h"
+#include "sidecarfile.h"
+
+using namespace Ilwis;
+using namespace Ilwis3;
+
+FeatureIndex::FeatureIndex()
+{
+}
+
+void FeatureIndex::build(const std::vector<Box> &boxes, const std::vector<quint32> &items) {
+    _boxes.clear();
+    _items.clear();
+    _levels.clear();
+    quint32 n = std::min(boxes.size(), items.size());
+    if ( n == 0)
+        return;
+
+    // sort tile recursive: vertical slices by x of the centers, each slice sorted by y, then packed in order
+    std::vector<quint32> order(n);
+    for(quint32 i = 0; i < n; ++i)
+        order[i] = i;
+    auto centerX = [&](quint32 i) { return boxes[i]._minx + boxes[i]._maxx; };
+    auto centerY = [&](quint32 i) { return boxes[i]._miny + boxes[i]._maxy; };
+    std::sort(order.begin(), order.end(), [&](quint32 a, quint32 b) { return centerX(a) < centerX(b); });
+    quint32 leaves = (n + NODESIZE - 1) / NODESIZE;
+    quint32 slices = std::ceil(std::sqrt((double)leaves));
+    quint64 sliceSize = (quint64)slices * NODESIZE;
+    for(quint64 begin = 0; begin < n; begin += sliceSize) {
+        auto end = order.begin() + std::min((quint64)n, begin + sliceSize);
+        std::sort(order.begin() + begin, end, [&](quint32 a, quint32 b) { return centerY(a) < centerY(b); });
+    }
+
+    _boxes.reserve(n + n / (NODESIZE - 1) + 1);
+    _items.resize(n);
+    for(quint32 i = 0; i < n; ++i) {
+        _boxes.push_back(boxes[order[i]]);
+        _items[i] = items[order[i]];
+    }
+    _levels.push_back(0);
+    _levels.push_back(n);
+    // each level has one node per NODESIZE consecutive entries of the level below, up to a single root
+    while ( _levels.back() - _levels[_levels.size() - 2] > 1) {
+        quint32 begin = _levels[_levels.size() - 2];
+        quint32 end = _levels.back();
+        for(quint32 first = begin; first < end; first += NODESIZE) {
+            Box node = _boxes[first];
+            for(quint32 i = first + 1; i < std::min(end, first + NODESIZE); ++i) {
+                node._minx = std::min(node._minx, _boxes[i]._minx);
+                node._miny = std::min(node._miny, _boxes[i]._miny);
+                node._maxx = std::max(node._maxx, _boxes[i]._maxx);
+                node._maxy = std::max(node._maxy, _boxes[i]._maxy);
+            }
+            _boxes.push_back(node);
+        }
+        _levels.push_back(_boxes.size());
+    }
+}
+
+std::vector<quint32> FeatureIndex::query(const Box &envelope) const {
+    std::vector<quint32> result;
+    if ( !isValid())
+        return result;
+    auto overlaps = [&](const Box& box) {
+        return box._minx <= envelope._maxx && box._maxx >= envelope._minx &&
+               box._miny <= envelope._maxy && box._maxy >= envelope._miny;
+    };
+    // pairs of level and position in _boxes
+    std::vector<std::pair<quint32, quint32>> stack(1, std::make_pair(_levels.size() - 2, _boxes.size() - 1));
+    while ( !stack.empty()) {
+        quint32 level = stack.back().first;
+        quint32 node = stack.back().second;
+        stack.pop_back();
+        if ( !overlaps(_boxes[node]))
+            continue;
+        if ( level == 0) {
+            result.push_back(_items[node]);
+            continue;
+        }
+        quint32 first = _levels[level - 1] + (node - _levels[level]) * NODESIZE;
+        quint32 last = std::min(_levels[level], first + NODESIZE);
+        for(quint32 child = first; child < last; ++child)
+            stack.push_back(std::make_pair(level - 1, child));
+    }
+    return result;
+}
+
+double FeatureIndex::distance(const Box &box, double x, double y) {
+    double dx = x < box._minx ? box._minx - x : (x > box._maxx ? x - box._maxx : 0);
+    double dy = y < box._miny ? box._miny - y : (y > box._maxy ? y - box._maxy : 0);
+    return dx * dx + dy * dy;
+}
+
+quint32 FeatureIndex::nearest(double x, double y) const {
+    // best first; the first leaf that comes off the queue has the envelope closest to the point
+    if ( !isValid())
+        return iUNDEF;
+    struct Entry{
+        double _distance;
+        quint32 _level;
+        quint32 _node;
+        bool operator<(const Entry& other) const { return _distance > other._distance; }
+    };
+    std::priority_queue<Entry> queue;
+    Entry root = {distance(_boxes.back(), x, y), (quint32)_levels.size() - 2, (quint32)_boxes.size() - 1};
+    queue.push(root);
+    while ( !queue.empty()) {
+        Entry entry = queue.top();
+        queue.pop();
+        if ( entry._level == 0)
+            return _items[entry._node];
+        quint32 first = _levels[entry._level - 1] + (entry._node - _levels[entry._level]) * NODESIZE;
+        quint32 last = std::min(_levels[entry._level], first + NODESIZE);
+        for(quint32 child = first; child < last; ++child) {
+            Entry next = {distance(_boxes[child], x, y), entry._level - 1, child};
+            queue.push(next);
+        }
+    }
+    return iUNDEF;
+}
+
+bool FeatureIndex::isValid() const {
+    return _items.size() > 0;
+}
+
+quint32 FeatureIndex::count() const {
+    return _items.size();
+}
+
+bool FeatureIndex::store(const QString &filename, const std::vector<QFileInfo> &sources) const {
+    if ( !isValid())
+        return false;
+    SidecarFile sidecar(filename, "STR2", sources);
+    Header header = {(quint32)_items.size(), (quint32)_levels.size()};
+    return sidecar.create() && sidecar.write(&header, sizeof(header)) &&
+           sidecar.write(_levels.data(), _levels.size() * sizeof(quint32)) &&
+           sidecar.write(_boxes.data(), _boxes.size() * sizeof(Box)) &&
+           sidecar.write(_items.data(), _items.size() * sizeof(quint32)) &&
+           sidecar.commit();
+}
+
+bool FeatureIndex::load(const QString &filename, const std::vector<QFileInfo> &sources) {
+    // only valid as long as none of the data files it was built from changed
+    SidecarFile sidecar(filename, "STR2", sources);
+    qint64 size;
+    const char *data = sidecar.map(size);
+    Header header;
+    if ( !data || size < (qint64)sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if ( header._count == 0 || header._levels < 2)
+        return false;
+    qint64 bytes = (qint64)header._levels * sizeof(quint32);
+    if ( size < (qint64)sizeof(header) + bytes)
+        return false;
+    std::vector<quint32> levels(header._levels);
+    memcpy(levels.data(), data + sizeof(header), bytes);
+    if ( levels[0] != 0 || levels[1] != header._count || levels.back() - levels[levels.size() - 2] != 1)
+        return false;
+    for(quint32 i = 1; i < levels.size(); ++i)
+        if ( levels[i] <= levels[i - 1])
+            return false;
+    if ( size != (qint64)(sizeof(header) + bytes + (qint64)levels.back() * sizeof(Box) + (qint64)header._count * sizeof(quint32)))
+        return false;
+    const char *p = data + sizeof(header) + bytes;
+    _levels.swap(levels);
+    _boxes.resize(_levels.back());
+    _items.resize(header._count);
+    memcpy(_boxes.data(), p, _boxes.size() * sizeof(Box));
+    memcpy(_items.data(), p + _boxes.size() * sizeof(Box), _items.size() * sizeof(quint32));
+    return true;
+}
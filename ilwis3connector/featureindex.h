@@ -0,0 +1,52 @@
+#ifndef FEATUREINDEX_H
+#define FEATUREINDEX_H
+
+namespace Ilwis {
+namespace Ilwis3{
+
+/*!
+ \brief packed R-tree (sort tile recursive) over the envelopes of the features of a map.
+
+ All nodes are kept level by level in flat arrays, leaves first, so the tree can be written to and read
+ from a sidecar file without any conversion. The items are the numbers the envelopes were added with.
+ */
+class FeatureIndex
+{
+public:
+    struct Box{
+        double _minx;
+        double _miny;
+        double _maxx;
+        double _maxy;
+    };
+
+    FeatureIndex();
+
+    void build(const std::vector<Box>& boxes, const std::vector<quint32>& items);
+    std::vector<quint32> query(const Box& envelope) const;
+    quint32 nearest(double x, double y) const;
+    bool isValid() const;
+    quint32 count() const;
+
+    bool store(const QString& filename, const std::vector<QFileInfo>& sources) const;
+    bool load(const QString& filename, const std::vector<QFileInfo>& sources);
+
+private:
+    static const quint32 NODESIZE = 16;
+
+    // start of the content of the sidecar file, followed by the levels, boxes and items
+    struct Header{
+        quint32 _count;
+        quint32 _levels;
+    };
+
+    static double distance(const Box& box, double x, double y);
+
+    std::vector<Box> _boxes; // the leaves, followed by the nodes of each higher level
+    std::vector<quint32> _items; // item of each leaf
+    std::vector<quint32> _levels; // start of each level in _boxes, plus the end of the root
+};
+}
+}
+
+#endif // FEATUREINDEX_H
@@ -2,6 +2,7 @@
 #include <QUrl>
 #include <QFileInfo>
 #include <QDir>
+#include <QRegExp>
 
 #include "kernel.h"
 #include "ilwisdata.h"
@@ -24,6 +25,9 @@
 using namespace Ilwis;
 using namespace Ilwis3;
 
+QHash<QString, SubMapInfo> GeorefConnector::_subMaps;
+std::mutex GeorefConnector::_subMapMutex;
+
 ConnectorInterface *GeorefConnector::create(const Resource &resource, bool load) {
     return new GeorefConnector(resource, load);
 
@@ -54,11 +58,14 @@ bool GeorefConnector::loadGeoref(const IniFile &odf, IlwisObject *data ) {
         //_type = itCORNERSGEOREF;
         return loadGeorefCorners(odf, data);
     } else if ( type == "GeoRefSubMap") {
-        QString name = odf.value("GeoRefSubMap","GeoRef");
-        QUrl resource = mastercatalog()->name2url(name, itGEOREF);
-        IniFile odf;
-        odf.setIniFile(resource);
-        return loadGeoref(odf,data);
+        SubMapInfo info;
+        if (!resolveSubMap(QUrl::fromLocalFile(odf.fileinfo().absoluteFilePath()), info))
+            return ERROR2(ERR_COULD_NOT_LOAD_2,"GeoRefSubMap",odf.fileinfo().baseName());
+        IniFile rootOdf;
+        rootOdf.setIniFile(info._root);
+        if (!loadGeoref(rootOdf,data))
+            return false;
+        return setSubMapEnvelope(grf, info, Size(columns, lines, 1));
     }
     //TODO tiepoints georef
     return false;
@@ -140,6 +147,23 @@ bool GeorefConnector::loadGeorefCorners(const IniFile& odf, IlwisObject *data) {
 }
 
 
+bool GeorefConnector::setSubMapEnvelope(GeoReference *grf, const SubMapInfo &info, const Size &sz) {
+    // the root georeference was loaded; cut the part covered by the sub map out of its envelope
+    if ( info._startRow + sz.ysize() > info._lines || info._startCol + sz.xsize() > info._columns)
+        return ERROR2(ERR_INVALID_PROPERTY_FOR_2,"Start Row/Col","GeoRefSubMap");
+    if ( !grf->grfType<CornersGeoReference>())
+        return false;
+    QSharedPointer<CornersGeoReference> cgrf = grf->impl<CornersGeoReference>();
+    Box2D<double> env = cgrf->envelope();
+    double pixx = (env.max_corner().x() - env.min_corner().x()) / info._columns;
+    double pixy = (env.max_corner().y() - env.min_corner().y()) / info._lines;
+    double minx = env.min_corner().x() + info._startCol * pixx;
+    double maxy = env.max_corner().y() - info._startRow * pixy;
+    grf->size(sz);
+    cgrf->setEnvelope(Box2D<double>(Coordinate(minx, maxy - sz.ysize() * pixy), Coordinate(minx + sz.xsize() * pixx, maxy)));
+    return true;
+}
+
 IlwisObject *GeorefConnector::createGeoreference(const IniFile &odf) const{
     QString type = odf.value("GeoRef","Type");
     if ( type == "GeoRefCorners"){
@@ -148,15 +172,87 @@ IlwisObject *GeorefConnector::createGeoreference(const IniFile &odf) const{
     }
     //TODO tiepoints georef
     if ( type == "GeoRefSubMap") {
-        auto name = _odf->value("GeoRefSubMap","GeoRef");
-        QUrl resource = mastercatalog()->name2url(name, itGEOREF);
-        IniFile odf;
-        odf.setIniFile(resource);
-        return createGeoreference(odf);
+        SubMapInfo info;
+        if (!resolveSubMap(QUrl::fromLocalFile(odf.fileinfo().absoluteFilePath()), info))
+            return 0;
+        IniFile rootOdf;
+        rootOdf.setIniFile(info._root);
+        return createGeoreference(rootOdf);
     }
     return 0;
 }
 
+bool GeorefConnector::subMapStart(const IniFile &odf, quint32 &row, quint32 &col) {
+    bool ok1, ok2;
+    row = odf.value("GeoRefSubMap","Start Row").toUInt(&ok1);
+    col = odf.value("GeoRefSubMap","Start Col").toUInt(&ok2);
+    if ( ok1 && ok2)
+        return true;
+    // older odf's store the start as a single rowcol
+    QStringList parts = odf.value("GeoRefSubMap","Start").split(QRegExp("[^0-9]+"), QString::SkipEmptyParts);
+    if ( parts.size() != 2)
+        return false;
+    row = parts[0].toUInt(&ok1);
+    col = parts[1].toUInt(&ok2);
+    return ok1 && ok2;
+}
+
+bool GeorefConnector::resolveSubMap(const QUrl &grf, SubMapInfo &info)
+{
+    QFileInfo inf(grf.toLocalFile());
+    if ( !inf.exists())
+        return ERROR1(ERR_MISSING_DATA_FILE_1, inf.fileName());
+
+    QString key = inf.absoluteFilePath();
+    Locker lock(_subMapMutex);
+    auto iter = _subMaps.find(key);
+    if ( iter != _subMaps.end() && isCurrent(iter.value())) {
+        info = iter.value();
+        return true;
+    }
+
+    SubMapInfo result;
+    QUrl current = grf;
+    for(int depth = 0; depth < 64; ++depth) { // a deeper chain is surely a cycle
+        IniFile odf;
+        if (!odf.setIniFile(current))
+            return ERROR1(ERR_COULD_NOT_OPEN_READING_1, current.toLocalFile());
+        QFileInfo link(current.toLocalFile());
+        result._chain.push_back(std::make_pair(link.absoluteFilePath(), link.lastModified()));
+        if ( odf.value("GeoRef","Type") != "GeoRefSubMap") {
+            bool ok1, ok2;
+            result._lines = odf.value("GeoRef","Lines").toUInt(&ok1);
+            result._columns = odf.value("GeoRef","Columns").toUInt(&ok2);
+            if ( !(ok1 && ok2))
+                return ERROR2(ERR_INVALID_PROPERTY_FOR_2,"Lines/Columns","Georeference");
+            result._root = current;
+            _subMaps[key] = result;
+            info = result;
+            return true;
+        }
+        quint32 row, col;
+        if ( subMapStart(odf, row, col)) {
+            result._startRow += row;
+            result._startCol += col;
+        }
+        current = mastercatalog()->name2url(odf.value("GeoRefSubMap","GeoRef"), itGEOREF);
+        if ( !current.isValid())
+            return ERROR2(ERR_COULD_NOT_LOAD_2,"GeoRefSubMap",odf.fileinfo().baseName());
+    }
+    return ERROR2(ERR_INVALID_PROPERTY_FOR_2,"GeoRef","GeoRefSubMap");
+}
+
+bool GeorefConnector::isCurrent(const SubMapInfo &info)
+{
+    // any georef in the chain may have been edited, not only the sub map itself
+    for(const auto& link : info._chain) {
+        QFileInfo inf(link.first);
+        if ( !inf.exists() || inf.lastModified() != link.second)
+            return false;
+    }
+    return info._chain.size() > 0;
+}
+
 IlwisObject *GeorefConnector::create() const
 {
     IniFile *odf = _odf.data();
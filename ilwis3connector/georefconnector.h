@@ -1,8 +1,24 @@
 #ifndef GEOREFCONNECTOR_H
 #define GEOREFCONNECTOR_H
 
+#include <QDateTime>
+
 namespace Ilwis {
 namespace Ilwis3 {
+
+/*!
+ \brief resolved GeoRefSubMap chain; the accumulated start row/column of the sub map relative to the root georeference
+ */
+struct SubMapInfo {
+    SubMapInfo() : _startRow(0), _startCol(0), _lines(0), _columns(0) {}
+    quint32 _startRow;
+    quint32 _startCol;
+    quint32 _lines; // size of the root georeference
+    quint32 _columns;
+    QUrl _root;
+    std::vector<std::pair<QString, QDateTime>> _chain; // every georef of the chain with its modification time
+};
+
 class GeorefConnector : public Ilwis3Connector
 {
 public:
@@ -12,11 +28,18 @@ public:
     IlwisObject *create() const;
 
     static ConnectorInterface *create(const Ilwis::Resource &resource, bool load=true);
+    static bool resolveSubMap(const QUrl &grf, SubMapInfo &info);
 
 private:
     bool loadGeoref(const IniFile &odf, IlwisObject *data);
     IlwisObject *createGeoreference(const IniFile &odf) const;
     bool loadGeorefCorners(const IniFile &odf, Ilwis::IlwisObject *data);
+    static bool subMapStart(const IniFile &odf, quint32 &row, quint32 &col);
+    static bool isCurrent(const SubMapInfo& info);
+    bool setSubMapEnvelope(GeoReference *grf, const SubMapInfo& info, const Size& sz);
+
+    static QHash<QString, SubMapInfo> _subMaps;
+    static std::mutex _subMapMutex;
 };
 }
 }
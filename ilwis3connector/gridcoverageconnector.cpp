@@ -2,8 +2,19 @@
 #include <QSqlError>
 #include <QFile>
 #include <QDir>
+#include <QDateTime>
 #include <fstream>
 #include <iterator>
+#include <thread>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 
 #include "kernel.h"
 #include "raster.h"
@@ -15,17 +26,22 @@
 #include "numericrange.h"
 #include "numericdomain.h"
 #include "catalog.h"
+#include "mastercatalog.h"
 #include "ilwiscontext.h"
 #include "pixeliterator.h"
 #include "ilwisobjectconnector.h"
 #include "ilwis3connector.h"
 #include "rawconverter.h"
 #include "coverageconnector.h"
+#include "georefconnector.h"
 #include "gridcoverageconnector.h"
 
 using namespace Ilwis;
 using namespace Ilwis3;
 
+QHash<quint64, RasterCoverageConnector::SourceStore> RasterCoverageConnector::_sources;
+std::mutex RasterCoverageConnector::_sourceMutex;
+
 ConnectorInterface *RasterCoverageConnector::create(const Resource &resource, bool load) {
     return new RasterCoverageConnector(resource, load);
 
@@ -33,7 +49,7 @@ ConnectorInterface *RasterCoverageConnector::create(const Resource &resource, bo
 
 
 
-RasterCoverageConnector::RasterCoverageConnector(const Resource &resource, bool load) : CoverageConnector(resource, load),_storesize(1)
+RasterCoverageConnector::RasterCoverageConnector(const Resource &resource, bool load) : CoverageConnector(resource, load),_startOffset(0), _rowLength(0), _storesize(1)
 {
 }
 
@@ -208,11 +224,47 @@ bool RasterCoverageConnector::loadMetaData(IlwisObject *data)
 
     gcoverage->georeference(grf);
     _dataType = gcoverage->datadef().range()->determineType();
+    setWindow(grfName, grf->size());
 
     return true;
 
 }
 
+void RasterCoverageConnector::setWindow(const QString& grfName, const Size& sz) {
+    // a map may be a window on a larger data file; either explicit through the MapStore offsets
+    // or implicit as a sub map that shares the data file of its parent
+    bool ok1, ok2;
+    _startOffset = _odf->value("MapStore","StartOffset").toLongLong(&ok1);
+    _rowLength = _odf->value("MapStore","RowLength").toUInt(&ok2);
+    if ( !ok1)
+        _startOffset = 0;
+    if ( !ok2 || _rowLength == 0)
+        _rowLength = sz.xsize();
+    if ( _startOffset != 0 || _rowLength != sz.xsize() || _dataFiles.size() == 0)
+        return;
+
+    SubMapInfo info;
+    QUrl grfUrl = mastercatalog()->name2url(grfName, itGEOREF);
+    IniFile grfOdf;
+    if ( !grfOdf.setIniFile(grfUrl) || grfOdf.value("GeoRef","Type") != "GeoRefSubMap")
+        return;
+    if (!GeorefConnector::resolveSubMap(grfUrl, info))
+        return;
+    // the data file must belong to a map on the root georeference; a sub map with its own data file is read as is
+    QFileInfo dataFile = _dataFiles[0];
+    IniFile ownerOdf;
+    QString owner = dataFile.absolutePath() + "/" + dataFile.completeBaseName() + ".mpr";
+    if ( QFileInfo(owner) == QFileInfo(_resource.toLocalFile()) || !QFileInfo(owner).exists() || !ownerOdf.setIniFile(QUrl::fromLocalFile(owner)))
+        return;
+    QUrl ownerGrf = mastercatalog()->name2url(ownerOdf.value("Map","GeoRef"), itGEOREF);
+    if ( QFileInfo(ownerGrf.toLocalFile()) != QFileInfo(info._root.toLocalFile()))
+        return;
+    if ( info._startRow + sz.ysize() > info._lines || info._startCol + sz.xsize() > info._columns)
+        return;
+    _rowLength = info._columns;
+    _startOffset = ((qint64)info._startRow * info._columns + info._startCol) * _storesize;
+}
+
 IlwisObject *RasterCoverageConnector::create() const
 {
     return new RasterCoverage(_resource);
@@ -245,12 +297,22 @@ qint64  RasterCoverageConnector::conversion(QFile& file, Grid *grid, int& count)
     qint64 totalRead =0;
     char *block = new char[blockSizeBytes];
     bool noconversionneeded = _converter.isNeutral();
+    qint64 rowBytes = grid->size().xsize() * _storesize;
+    bool windowed = _dataFiles.size() == 1 && (_startOffset != 0 || (_rowLength != 0 && _rowLength != grid->size().xsize()));
+    qint64 row = 0;
     while(szLeft > 0) {
-        if ( szLeft >= blockSizeBytes)
-            result = file.read((char *)block,blockSizeBytes);
-        else {
-            result = file.read((char *)block,szLeft);
-        }
+        qint64 toRead = std::min(szLeft, blockSizeBytes);
+        if ( windowed) { // rows of the window are not adjacent in the file, seek per row
+            result = 0;
+            for(qint64 offset = 0; offset < toRead; offset += rowBytes, ++row) {
+                if (!file.seek(_startOffset + row * _rowLength * _storesize) || file.read(block + offset, rowBytes) != rowBytes) {
+                    result = -1;
+                    break;
+                }
+                result += rowBytes;
+            }
+        } else
+            result = file.read((char *)block,toRead);
         if ( result == -1){
             kernel()->issues()->log(TR("Reading past the end of file %1").arg(_dataFiles[0].fileName()));
             break;
@@ -263,6 +325,7 @@ qint64  RasterCoverageConnector::conversion(QFile& file, Grid *grid, int& count)
             double v = value(block, i);
 
             values[i] = noconversionneeded ? v :_converter.raw2real(v);
+            _digest.add(values[i]);
         }
         grid->setBlock(count, values, true);
         totalRead += result;
@@ -292,6 +355,7 @@ Grid* RasterCoverageConnector::loadGridData(IlwisObject* data)
     }
     grid->prepare();
 
+    _digest = PixelDigest();
     for(quint32 i=0; i < _dataFiles.size(); ++i) {
         QFile file(_dataFiles[i].absoluteFilePath());
         if ( !file.exists()){
@@ -322,10 +386,193 @@ Grid* RasterCoverageConnector::loadGridData(IlwisObject* data)
             tbl->cell(COVERAGEKEYCOLUMN,i, i);
         }
     }
+    registerSource(raster);
     return grid;
 
 }
 
+void RasterCoverageConnector::registerSource(const RasterCoverage *raster) {
+    // only a single data file that holds exactly this raster can be copied
+    bool windowed = _startOffset != 0 || (_rowLength != 0 && _rowLength != raster->size().xsize());
+    Locker lock(_sourceMutex);
+    if ( _dataFiles.size() != 1 || windowed) {
+        _sources.remove(raster->id());
+        return;
+    }
+    SourceStore source;
+    QFileInfo inf(_dataFiles[0].absoluteFilePath());
+    source._dataFile = inf.absoluteFilePath();
+    source._size = inf.size();
+    source._modified = inf.lastModified().toMSecsSinceEpoch();
+    source._storetype = _storetype;
+    source._converter = _converter;
+    source._digest = _digest;
+    _sources[raster->id()] = source;
+}
+
+bool RasterCoverageConnector::copySource(const IRasterCoverage& raster, const RawConverter& conv, IlwisTypes storetype, const QString& filename) const {
+    // the source data file is copied when it holds exactly what encoding the raster would produce: the same
+    // store type and converter (scale, offset and undefined) and pixels that did not change since the load
+    SourceStore source;
+    {
+        Locker lock(_sourceMutex);
+        auto iter = _sources.find(raster->id());
+        if ( iter == _sources.end())
+            return false;
+        source = iter.value();
+    }
+    QFileInfo inf(source._dataFile);
+    if ( !inf.exists() || inf.size() != source._size || inf.lastModified().toMSecsSinceEpoch() != source._modified)
+        return false;
+    if ( source._storetype != storetype || !(source._converter == conv))
+        return false;
+    PixelDigest digest;
+    PixelIterator iter(raster,Box3D<>(raster->size()));
+    for_each(iter, iter.end(), [&](double& v){
+        digest.add(v);
+    });
+    if ( !(digest == source._digest))
+        return false;
+    if ( inf == QFileInfo(filename)) // stored onto its own source, nothing to write
+        return true;
+    return copyDataFile(source._dataFile, filename);
+}
+
+bool RasterCoverageConnector::copyDataFile(const QString& source, const QString& target) {
+    // a reflink shares the blocks on file systems that support it, copy_file_range copies inside the kernel
+#ifdef Q_OS_LINUX
+    int in = ::open(source.toLocal8Bit(), O_RDONLY);
+    if ( in != -1) {
+        int out = ::open(target.toLocal8Bit(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = false;
+        if ( out != -1) {
+            ok = ioctl(out, FICLONE, in) == 0;
+            struct stat st;
+            if ( !ok && fstat(in, &st) == 0) {
+                off_t left = st.st_size;
+                ok = true;
+                while(ok && left > 0) {
+                    ssize_t copied = copy_file_range(in, 0, out, 0, left, 0);
+                    if ( copied <= 0)
+                        ok = false;
+                    else
+                        left -= copied;
+                }
+            }
+            if ( ::close(out) != 0)
+                ok = false;
+        }
+        ::close(in);
+        if ( ok)
+            return true;
+    }
+#endif
+    QFile::remove(target);
+    return QFile::copy(source, target);
+}
+
+void RasterCoverageConnector::readBand(std::vector<double>& values, const IRasterCoverage& raster, const Size& sz, qint32 ystart, qint32 yend) const {
+    PixelIterator pixiter(raster,Box3D<>(Voxel(0, ystart, 0), Voxel(sz.xsize() - 1, yend - 1, 0)));
+    values.resize((quint64)sz.xsize() * (yend - ystart));
+    quint64 i = 0;
+    for_each(pixiter, pixiter.end(), [&](double& v){
+        values[i++] = v;
+    });
+}
+
+template<typename T> void RasterCoverageConnector::encodeBand(const std::vector<double>& values, const RawConverter& conv, std::vector<T>& buffer) {
+    buffer.resize(values.size());
+    for(quint64 i = 0; i < values.size(); ++i)
+        buffer[i] = conv.real2raw(values[i]);
+}
+
+#ifdef Q_OS_UNIX
+static bool preallocate(int fd, qint64 size) {
+    // reserves the blocks up front where the platform can; otherwise only sets the size
+#ifdef Q_OS_LINUX
+    if ( posix_fallocate(fd, 0, size) == 0)
+        return true;
+#endif
+    return ftruncate(fd, size) == 0;
+}
+
+static bool writeAt(int fd, const char *ptr, qint64 bytes, off_t offset) {
+    while( bytes > 0) {
+        ssize_t written = pwrite(fd, ptr, bytes, offset);
+        if ( written <= 0)
+            return false;
+        ptr += written;
+        offset += written;
+        bytes -= written;
+    }
+    return true;
+}
+#endif
+
+template<typename T> bool RasterCoverageConnector::save(const QString& filename, const RawConverter& conv, const IRasterCoverage& raster, const Size& sz) const{
+    // bands of rows are encoded independently. The grid only supports one iterator at a time, so this thread
+    // reads a batch of bands and forBands encodes them, each band into its own buffer
+    const quint64 BANDPIXELS = 262144;
+    quint32 batch = std::max(1U, std::thread::hardware_concurrency());
+    qint32 linesPerBand = std::max((quint64)1, BANDPIXELS / std::max((quint64)1, (quint64)sz.xsize()));
+    qint32 lines = sz.ysize();
+    std::vector<std::vector<double>> values(batch);
+    std::vector<std::vector<T>> buffers(batch);
+    auto readBatch = [&](qint32 ystart) {
+        quint32 bands = 0;
+        for(qint32 y = ystart; bands < batch && y < lines; y += linesPerBand, ++bands)
+            readBand(values[bands], raster, sz, y, std::min(lines, y + linesPerBand));
+        return bands;
+    };
+#ifdef Q_OS_UNIX
+    // row offsets in the .mp# are fixed, so every band is written at its own offset by the thread that encoded it
+    int fd = ::open(filename.toLocal8Bit(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if ( fd == -1)
+        return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
+    qint64 rowBytes = (qint64)sz.xsize() * sizeof(T);
+    if ( !preallocate(fd, rowBytes * lines)) {
+        ::close(fd);
+        return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
+    }
+    std::vector<char> written(batch, 1);
+    bool ok = true;
+    for(qint32 ystart = 0; ok && ystart < lines; ystart += linesPerBand * batch) {
+        quint32 bands = readBatch(ystart);
+        forBands(0, bands, 1, [&](quint32 first, quint32 last) {
+            for(quint32 b = first; b < last; ++b) {
+                encodeBand(values[b], conv, buffers[b]);
+                off_t offset = (off_t)(ystart + b * linesPerBand) * rowBytes;
+                written[b] = writeAt(fd, reinterpret_cast<const char *>(buffers[b].data()), buffers[b].size() * sizeof(T), offset);
+            }
+        });
+        for(quint32 b = 0; b < bands; ++b)
+            ok = ok && written[b];
+    }
+    if ( ::close(fd) != 0)
+        ok = false;
+    if ( !ok)
+        return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
+    return true;
+#else
+    std::ofstream output_file(filename.toLatin1(),ios_base::out | ios_base::binary | ios_base::trunc);
+    if ( !output_file.is_open())
+        return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
+    for(qint32 ystart = 0; output_file.good() && ystart < lines; ystart += linesPerBand * batch) {
+        quint32 bands = readBatch(ystart);
+        forBands(0, bands, 1, [&](quint32 first, quint32 last) {
+            for(quint32 b = first; b < last; ++b)
+                encodeBand(values[b], conv, buffers[b]);
+        });
+        for(quint32 b = 0; b < bands; ++b)
+            output_file.write(reinterpret_cast<const char *>(buffers[b].data()), buffers[b].size() * sizeof(T));
+    }
+    output_file.close();
+    if ( output_file.fail())
+        return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
+    return true;
+#endif
+}
+
 bool RasterCoverageConnector::storeBinaryData(IlwisObject *obj)
 {
     Locker lock(_mutex);
@@ -355,36 +602,37 @@ bool RasterCoverageConnector::storeBinaryData(IlwisObject *obj)
         const NumericStatistics& stats = raster->statistics();
         RawConverter conv(stats[NumericStatistics::pMIN], stats[NumericStatistics::pMAX],pow(10, - stats.significantDigits()));
 
-
-        std::ofstream output_file(filename.toLatin1(),ios_base::out | ios_base::binary | ios_base::trunc);
-        if ( !output_file.is_open())
-            return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
-
         if ( conv.storeType() == itUINT8) {
-            ok = save<quint8>(output_file,conv.scale() == 1 ? RawConverter() : conv, raster,sz);
+            if ( copySource(raster, conv.scale() == 1 ? RawConverter() : conv, itUINT8, filename))
+                return true;
+            ok = save<quint8>(filename,conv.scale() == 1 ? RawConverter() : conv, raster,sz);
         } else if ( conv.storeType() == itINT16) {
-            ok = save<qint16>(output_file,conv, raster,sz);
+            if ( copySource(raster, conv, itINT16, filename))
+                return true;
+            ok = save<qint16>(filename,conv, raster,sz);
         } else if ( conv.storeType() == itINT32) {
-            save<qint32>(output_file,conv, raster,sz);
+            if ( copySource(raster, conv, itINT32, filename))
+                return true;
+            ok = save<qint32>(filename,conv, raster,sz);
         } else {
-            ok = save<double>(output_file,conv, raster,sz);
+            if ( copySource(raster, conv, itDOUBLE, filename))
+                return true;
+            ok = save<double>(filename,conv, raster,sz);
         }
-        output_file.close();
 
     } else if ( dom->ilwisType() == itITEMDOMAIN ){
         if ( hasType(dom->valueType(), itTHEMATICITEM | itNAMEDITEM)) {
-            std::ofstream output_file(filename.toLatin1(),ios_base::out | ios_base::binary | ios_base::trunc);
-            if ( !output_file.is_open()){
-                return ERROR1(ERR_COULD_NOT_OPEN_WRITING_1,filename);
-            }
-
             if( hasType(dom->valueType(), itTHEMATICITEM)){
                 RawConverter conv("class");
-                ok = save<quint8>(output_file,conv, raster,sz);
+                if ( copySource(raster, conv, itUINT8, filename))
+                    return true;
+                ok = save<quint8>(filename,conv, raster,sz);
             }
             else{
                 RawConverter conv("ident");
-                ok = save<quint16>(output_file,conv, raster,sz);
+                if ( copySource(raster, conv, itINT16, filename))
+                    return true;
+                ok = save<quint16>(filename,conv, raster,sz);
             }
         }
     }
@@ -22,6 +22,32 @@ public:
     void calcStatics(const IlwisObject *obj,NumericStatistics::PropertySets set) const;
 
 private:
+    // the grid has no modification flag the connector can see, so it keeps a digest of the pixels it delivered
+    class PixelDigest {
+    public:
+        PixelDigest() : _hash(0x9E3779B97F4A7C15ULL), _count(0) {}
+        void add(double v) {
+            quint64 bits;
+            memcpy(&bits, &v, 8);
+            _hash ^= bits * 0xC2B2AE3D27D4EB4FULL;
+            _hash = ((_hash << 31) | (_hash >> 33)) * 0x9E3779B185EBCA87ULL;
+            ++_count;
+        }
+        bool operator==(const PixelDigest& digest) const { return _hash == digest._hash && _count == digest._count; }
+    private:
+        quint64 _hash;
+        quint64 _count;
+    };
+    // the data file a raster was loaded from, as long as it can be copied instead of encoded again
+    struct SourceStore {
+        QString _dataFile;
+        qint64 _size;
+        qint64 _modified;
+        IlwisTypes _storetype;
+        RawConverter _converter;
+        PixelDigest _digest;
+    };
+
     qint64 conversion(QFile &file, Ilwis::Grid *grid, int &count);
     //qint64 noconversionneeded(QFile &file, Ilwis::Grid *grid, int &count);
     double value(char *block, int index) const;
@@ -30,26 +56,25 @@ private:
     bool storeMetaDataMapList(Ilwis::IlwisObject *obj);
     QString getGrfName(const IRasterCoverage &raster);
     bool setDataDefinition(IlwisObject *data);
+    void setWindow(const QString &grfName, const Size &sz);
+    void registerSource(const RasterCoverage *raster);
+    bool copySource(const IRasterCoverage &raster, const RawConverter &conv, IlwisTypes storetype, const QString &filename) const;
+    static bool copyDataFile(const QString &source, const QString &target);
 
-    template<typename T> bool save(std::ofstream& output_file,const RawConverter& conv, const IRasterCoverage& raster, const Size& sz) const{
-        PixelIterator pixiter(raster,Box3D<>(sz));
-        int  i=0;
-        T c = 0;
-        const char *ptr = reinterpret_cast<const char*>(&c);
-        //std::ofstream dum("d:/dummyout.txt",ios_base::out | ios_base::trunc);
-        for_each(pixiter, pixiter.end(), [&](double& v){
-            c = conv.real2raw(v);
-             ++i;
-            output_file.write(ptr, sizeof(T));
-            //dum << v << " ";
-       });
-        return true;
-    }
+    template<typename T> bool save(const QString& filename,const RawConverter& conv, const IRasterCoverage& raster, const Size& sz) const;
+    void readBand(std::vector<double>& values, const IRasterCoverage& raster, const Size& sz, qint32 ystart, qint32 yend) const;
+    template<typename T> static void encodeBand(const std::vector<double>& values, const RawConverter& conv, std::vector<T>& buffer);
 
     vector<QFileInfo> _dataFiles;
+    qint64 _startOffset;
+    quint32 _rowLength;
     int _storesize;
     IlwisTypes _storetype;
     IlwisTypes _dataType;
+    PixelDigest _digest;
+
+    static QHash<quint64, SourceStore> _sources;
+    static std::mutex _sourceMutex;
 };
 }
 }
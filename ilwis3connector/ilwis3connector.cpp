@@ -1,6 +1,7 @@
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QUrl>
+#include <QFile>
 #include "inifile.h"
 #include "kernel.h"
 #include "ilwisdata.h"
@@ -62,11 +63,7 @@ bool Ilwis3Connector::storeMetaData(const IlwisObject *obj, IlwisTypes type) con
         return false;
     }
 
-    QString name = _resource.url().toLocalFile();
-    QString ext = suffix(type);
-    if ( name.indexOf("." + ext) == -1)
-        name += "." + ext;
-    QFileInfo inf(name);
+    QFileInfo inf(odfName(type));
     IniFile *ini = new IniFile();
     ini->setIniFile(inf.absoluteFilePath(), false);
     _odf.reset(ini);
@@ -318,6 +315,74 @@ QString Ilwis3Connector::filename2FullPath(const QString& name) const {
     return sUNDEF;
 }
 
+bool Ilwis3Connector::appendRequested() const
+{
+    QVariant append = _resource["append"];
+    return append.isValid() && append.toBool();
+}
+
+QString Ilwis3Connector::odfName(IlwisTypes type) const
+{
+    QString name = _resource.url().toLocalFile();
+    QString ext = suffix(type);
+    if ( name.indexOf("." + ext) == -1)
+        name += "." + ext;
+    return name;
+}
+
+void Ilwis3Connector::keepStoredData() const
+{
+    // the keys describe the data file, which a metadata store leaves alone; they go to the new ODF unchanged
+    QFileInfo inf = _odf->fileinfo();
+    if ( !inf.exists())
+        return;
+    IniFile old;
+    old.setIniFile(inf.absoluteFilePath());
+    for(const QString& key : {"StoredRecords", "StoredSize", "StoredLayout"}) {
+        QString value = old.value("TableStore", key);
+        if ( value != sUNDEF)
+            _odf->setKeyValue("TableStore", key, value);
+    }
+}
+
+void Ilwis3Connector::setStoredData(IlwisTypes type, quint32 records, const QString &datafile, const QString &layout) const
+{
+    QFileInfo inf(odfName(type));
+    if ( !inf.exists())
+        return;
+    IniFile odf;
+    odf.setIniFile(inf.absoluteFilePath());
+    odf.setKeyValue("TableStore", "StoredRecords", QString::number(records));
+    odf.setKeyValue("TableStore", "StoredSize", QString::number(QFileInfo(datafile).size()));
+    odf.setKeyValue("TableStore", "StoredLayout", layout);
+    odf.store();
+}
+
+bool Ilwis3Connector::storedRecords(IlwisTypes type, const QString &datafile, quint32 records, const QString &layout, quint32 &stored) const
+{
+    // appending needs the layout of the last binary store, no more records than there are now, and a data file
+    // that has not changed size since
+    QFileInfo inf(odfName(type));
+    QFileInfo data(datafile);
+    if ( !inf.exists() || !data.exists())
+        return false;
+    IniFile odf;
+    odf.setIniFile(inf.absoluteFilePath());
+    bool ok1, ok2;
+    stored = odf.value("TableStore", "StoredRecords").toUInt(&ok1);
+    qint64 size = odf.value("TableStore", "StoredSize").toLongLong(&ok2);
+    return ok1 && ok2 && stored <= records && size == data.size() &&
+            odf.value("TableStore", "StoredLayout") == layout;
+}
+
+bool Ilwis3Connector::endsWith(const QString &datafile, const char *bytes, qint64 length)
+{
+    QFile file(datafile);
+    if ( !file.open(QIODevice::ReadOnly) || file.size() < 128 + length || !file.seek(file.size() - length))
+        return false;
+    return file.read(length) == QByteArray::fromRawData(bytes, length);
+}
+
 
 
 
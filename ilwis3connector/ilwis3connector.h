@@ -2,6 +2,7 @@
 #define ILWIS3CONNECTOR_H
 
 #include <QScopedPointer>
+#include <thread>
 #include "Ilwis3Connector_global.h"
 
 
@@ -34,9 +35,31 @@ protected:
     QString noExt(const QString& name);
     QString filename2FullPath(const QString &name) const;
 
+    bool appendRequested() const;
+    QString odfName(IlwisTypes type) const;
+    void keepStoredData() const;
+    void setStoredData(IlwisTypes type, quint32 records, const QString &datafile, const QString &layout) const;
+    bool storedRecords(IlwisTypes type, const QString &datafile, quint32 records, const QString &layout, quint32 &stored) const;
+    static bool endsWith(const QString &datafile, const char *bytes, qint64 length);
+
     mutable ODF _odf;
 
 };
+
+/*!
+ \brief calls func(begin, end) for contiguous bands of [first, last), one band per thread; returns when all are done.
+ No more threads than leave each band at least minPerThread items.
+ */
+template<typename Func> void forBands(quint32 first, quint32 last, quint32 minPerThread, Func func) {
+    quint32 threads = std::max(1U, std::min(std::thread::hardware_concurrency(), (last - first) / minPerThread));
+    quint32 band = (last - first) / threads;
+    std::vector<std::thread> workers;
+    for(quint32 t = 1; t < threads; ++t)
+        workers.push_back(std::thread(func, first + t * band, t == threads - 1 ? last : first + (t + 1) * band));
+    func(first, threads == 1 ? last : first + band);
+    for(std::thread& worker : workers)
+        worker.join();
+}
 }
 
 }
@@ -195,7 +195,7 @@ void IniFile::store(const QString& ext)
     }
     QFile fileIni(path);
 
-    if (!fileIni.open(QIODevice::ReadWrite | QIODevice::Text))
+    if (!fileIni.open(QIODevice::ReadWrite | QIODevice::Truncate | QIODevice::Text))
         return;
 
     QTextStream text(&fileIni);
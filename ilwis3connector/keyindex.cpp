@@ -0,0 +1,104 @@
+#include <QString>
+#include <QFile>
+#include <QFileInfo>
+#include <cmath>
+#include <cstring>
+
+#include "kernel.h"
+#include "keyindex.h"
+#include "sidecarfile.h"
+
+using namespace Ilwis;
+using namespace Ilwis3;
+
+KeyIndex::KeyIndex() : _count(0)
+{
+}
+
+quint64 KeyIndex::hash(qint64 key) {
+    // 64 bit finalizer of murmur3; consecutive ids end up far apart
+    quint64 h = key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void KeyIndex::build(const std::vector<double> &keys) {
+    quint64 capacity = 16;
+    while ( capacity < keys.size() * 2) // at most half full keeps the probe sequences short
+        capacity *= 2;
+    _keys.assign(capacity, 0);
+    _rows.assign(capacity, iUNDEF);
+    _count = 0;
+    quint64 mask = capacity - 1;
+    for(quint32 r = 0; r < keys.size(); ++r) {
+        if ( keys[r] == rUNDEF)
+            continue;
+        qint64 key = std::llround(keys[r]);
+        quint64 slot = hash(key) & mask;
+        while ( _rows[slot] != iUNDEF && _keys[slot] != key)
+            slot = (slot + 1) & mask;
+        if ( _rows[slot] != iUNDEF)
+            continue;
+        _keys[slot] = key;
+        _rows[slot] = r;
+        ++_count;
+    }
+}
+
+quint32 KeyIndex::row(qint64 key) const {
+    if ( _rows.size() == 0)
+        return iUNDEF;
+    quint64 mask = _rows.size() - 1;
+    quint64 slot = hash(key) & mask;
+    while ( _rows[slot] != iUNDEF) {
+        if ( _keys[slot] == key)
+            return _rows[slot];
+        slot = (slot + 1) & mask;
+    }
+    return iUNDEF;
+}
+
+bool KeyIndex::isValid() const {
+    return _rows.size() > 0;
+}
+
+quint32 KeyIndex::count() const {
+    return _count;
+}
+
+bool KeyIndex::store(const QString &filename, const QFileInfo &datafile) const {
+    if ( !isValid())
+        return false;
+    SidecarFile sidecar(filename, "KIX2", {datafile});
+    Header header = {_count, 0, _rows.size()};
+    return sidecar.create() && sidecar.write(&header, sizeof(header)) &&
+           sidecar.write(_keys.data(), _keys.size() * sizeof(qint64)) &&
+           sidecar.write(_rows.data(), _rows.size() * sizeof(quint32)) &&
+           sidecar.commit();
+}
+
+bool KeyIndex::load(const QString &filename, const QFileInfo &datafile) {
+    // only valid as long as the data file it was built from did not change
+    SidecarFile sidecar(filename, "KIX2", {datafile});
+    qint64 size;
+    const char *data = sidecar.map(size);
+    Header header;
+    if ( !data || size < (qint64)sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    quint64 capacity = header._capacity;
+    if ( capacity == 0 || (capacity & (capacity - 1)) != 0 || header._count > capacity ||
+         capacity > (quint64)(size / (sizeof(qint64) + sizeof(quint32))) ||
+         size != (qint64)(sizeof(header) + capacity * (sizeof(qint64) + sizeof(quint32))))
+        return false;
+    _keys.resize(capacity);
+    _rows.resize(capacity);
+    memcpy(_keys.data(), data + sizeof(header), capacity * sizeof(qint64));
+    memcpy(_rows.data(), data + sizeof(header) + capacity * sizeof(qint64), capacity * sizeof(quint32));
+    _count = header._count;
+    return true;
+}
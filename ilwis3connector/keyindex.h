@@ -0,0 +1,43 @@
+#ifndef KEYINDEX_H
+#define KEYINDEX_H
+
+namespace Ilwis {
+namespace Ilwis3{
+
+/*!
+ \brief hash index from the values of a key column to the rows they occur in.
+
+ Open addressing over two flat arrays, so it can be written to and read from a sidecar file without any
+ conversion. When a key occurs more than once the first row is used.
+ */
+class KeyIndex
+{
+public:
+    KeyIndex();
+
+    void build(const std::vector<double>& keys);
+    quint32 row(qint64 key) const;
+    bool isValid() const;
+    quint32 count() const;
+
+    bool store(const QString& filename, const QFileInfo& datafile) const;
+    bool load(const QString& filename, const QFileInfo& datafile);
+
+private:
+    // start of the content of the sidecar file, followed by the keys and the rows
+    struct Header{
+        quint32 _count;
+        quint32 _reserved;
+        quint64 _capacity;
+    };
+
+    static quint64 hash(qint64 key);
+
+    std::vector<qint64> _keys;
+    std::vector<quint32> _rows; // iUNDEF for an empty slot
+    quint32 _count;
+};
+}
+}
+
+#endif // KEYINDEX_H
@@ -58,6 +58,10 @@ public:
         return _offset == 0 && _scale == 1.0;
     }
 
+    bool operator==(const RawConverter& conv) const{
+        return _offset == conv._offset && _scale == conv._scale && _storeType == conv._storeType && _undefined == conv._undefined;
+    }
+
     double offset() const {
         return _offset;
     }
@@ -88,6 +92,14 @@ public:
         return _storeType != itUNKNOWN;
     }
 
+    double undefined() const{
+        return _undefined;
+    }
+
+    void raw2real(const qint32 *raw, quint64 count, double *real) const;
+    void raw2real(const double *raw, quint64 count, double *real) const;
+    void real2raw(const double *real, quint64 count, qint32 *raw) const;
+
 private:
     double guessUndef(double vmin, double vmax);
     long rounding(double x) const;
@@ -103,6 +115,46 @@ private:
 
 
 };
+
+/*!
+ \brief raw to real conversion of a whole column, with the store type and the scaling fixed at compile time.
+
+ The undefined checks are selects instead of branches, so loops over a column can be vectorized. Gives the
+ same values as RawConverter::raw2real.
+ */
+template<typename RawType, bool Neutral> class RawDecoder
+{
+public:
+    RawDecoder(const RawConverter& conv) : _offset(conv.offset()), _scale(conv.scale()), _undefined(conv.undefined()) {}
+
+    double operator()(RawType raw) const {
+        double v = raw;
+        double real = Neutral ? v : (v + _offset) * _scale;
+        return (v == _undefined) | (v == 0) ? rUNDEF : real;
+    }
+
+private:
+    double _offset;
+    double _scale;
+    double _undefined;
+};
+
+//! the inverse of RawDecoder; same values as RawConverter::real2raw
+template<typename RawType, bool Neutral> class RawEncoder
+{
+public:
+    RawEncoder(const RawConverter& conv) : _offset(conv.offset()), _scale(conv.scale()), _undefined(conv.undefined()) {}
+
+    RawType operator()(double real) const {
+        double raw = Neutral ? real : real / _scale - _offset;
+        return (RawType)(real == rUNDEF ? _undefined : raw);
+    }
+
+private:
+    double _offset;
+    double _scale;
+    double _undefined;
+};
 }
 }
 
@@ -0,0 +1,107 @@
+#include <QString>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QCoreApplication>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "kernel.h"
+#include "sidecarfile.h"
+
+using namespace Ilwis;
+using namespace Ilwis3;
+
+SidecarFile::SidecarFile(const QString &filename, const char *magic, const std::vector<QFileInfo> &sources) :
+    _filename(filename),
+    _failed(false)
+{
+    // unique per process and object, so concurrent writers never share a temporary file
+    static std::atomic<quint32> counter(0);
+    _temporary = QString("%1.%2.%3.tmp").arg(filename).arg(QCoreApplication::applicationPid()).arg(counter++);
+
+    if ( magic) {
+        quint32 count = sources.size();
+        _header.append(magic, 4);
+        _header.append((const char *)&count, 4);
+    }
+    for(QFileInfo inf : sources) {
+        inf.refresh();
+        qint64 stamp[2] = {inf.exists() ? inf.size() : -1, inf.lastModified().toMSecsSinceEpoch()};
+        if ( magic)
+            _header.append((const char *)stamp, sizeof(stamp));
+        _stamp += QString("%1:%2;").arg(stamp[0]).arg(stamp[1]);
+    }
+}
+
+SidecarFile::~SidecarFile()
+{
+    // whatever was not committed is discarded
+    _file.close();
+    QFile::remove(_temporary);
+}
+
+const char *SidecarFile::map(qint64 &size)
+{
+    // the content after the header, as long as the header matches the current sources
+    size = 0;
+    _file.setFileName(_filename);
+    if ( _header.isEmpty() || !_file.open(QIODevice::ReadOnly))
+        return 0;
+    qint64 fileSize = _file.size();
+    if ( fileSize < _header.size())
+        return 0;
+    const char *data = (const char *)_file.map(0, fileSize);
+    if ( !data || memcmp(data, _header.constData(), _header.size()) != 0)
+        return 0;
+    size = fileSize - _header.size();
+    return data + _header.size();
+}
+
+bool SidecarFile::create()
+{
+    _file.close();
+    _file.setFileName(_temporary);
+    _failed = !_file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    return write(_header.constData(), _header.size());
+}
+
+bool SidecarFile::write(const void *data, qint64 bytes)
+{
+    if ( !_failed && bytes > 0 && _file.write((const char *)data, bytes) != bytes)
+        _failed = true;
+    return !_failed;
+}
+
+bool SidecarFile::commit()
+{
+    // moves a complete temporary file in place; rename replaces an existing file atomically where the platform allows it
+    if ( _file.isOpen()) {
+        _failed = _failed || !_file.flush();
+        _file.close();
+    }
+    bool ok = !_failed && QFileInfo(_temporary).exists();
+    if ( ok && std::rename(_temporary.toLocal8Bit(), _filename.toLocal8Bit()) != 0) {
+        QFile::remove(_filename);
+        ok = QFile::rename(_temporary, _filename);
+    }
+    if ( !ok)
+        QFile::remove(_temporary);
+    return ok;
+}
+
+QString SidecarFile::filename() const
+{
+    return _filename;
+}
+
+QString SidecarFile::temporary() const
+{
+    return _temporary;
+}
+
+QString SidecarFile::stamp() const
+{
+    return _stamp;
+}
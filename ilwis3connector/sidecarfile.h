@@ -0,0 +1,44 @@
+#ifndef SIDECARFILE_H
+#define SIDECARFILE_H
+
+#include <QFile>
+
+namespace Ilwis {
+namespace Ilwis3{
+
+/*!
+ \brief a file derived from ILWIS3 data files and kept next to them (row index, ring cache, spatial index, columnar cache).
+
+ The header records the size and modification time of every source file; the content is only used while all
+ of them are unchanged. A new file is written aside and moved in place once complete, so a reader never sees
+ a partial file. Failing to write one is harmless, it is derived again on the next load.
+ Files in a format of their own (no magic) keep stamp() somewhere in their content and are written to
+ temporary() before commit().
+ */
+class SidecarFile
+{
+public:
+    SidecarFile(const QString& filename, const char *magic, const std::vector<QFileInfo>& sources);
+    ~SidecarFile();
+
+    const char *map(qint64& size);
+    bool create();
+    bool write(const void *data, qint64 bytes);
+    bool commit();
+
+    QString filename() const;
+    QString temporary() const;
+    QString stamp() const;
+
+private:
+    QString _filename;
+    QString _temporary;
+    QByteArray _header;
+    QString _stamp;
+    QFile _file;
+    bool _failed;
+};
+}
+}
+
+#endif // SIDECARFILE_H
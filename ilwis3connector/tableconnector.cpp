@@ -1,5 +1,6 @@
 #include <QSqlQuery>
 #include <QSqlError>
+#include <QFileInfo>
 
 #include "kernel.h"
 #include "angle.h"
@@ -29,6 +30,7 @@
 #include "tableconnector.h"
 #include "rawconverter.h"
 #include "binaryilwis3table.h"
+#include "keyindex.h"
 #include "domainconnector.h"
 #include "ilwis3range.h"
 #include "ilwiscontext.h"
@@ -128,8 +130,10 @@ ColumnDefinition TableConnector::getKeyColumn() {
 bool TableConnector::loadBinaryData(IlwisObject* data ) {
     Locker lock(_mutex);
 
+    // on request the decoded table is kept in a columnar cache next to the data file; later loads only map it
+    QVariant cache = _resource["arrowcache"];
     Ilwis3::BinaryIlwis3Table tbl ;
-    if (!tbl.load(_odf)) // no table found?
+    if (!tbl.load(_odf, "", QStringList(), cache.isValid() && cache.toBool())) // no table found?
         return false;
     Table *table = static_cast<Table *>(data);
 
@@ -143,19 +147,11 @@ bool TableConnector::loadBinaryData(IlwisObject* data ) {
             std::vector<QVariant> varlist(tbl.rows());
             RawConverter conv = _converters[colName];
             IlwisTypes valueType = col.datadef().domain()->valueType();
-            for(quint32 j = 0; j < tbl.rows(); ++j){
-                if ( (valueType >= itINT8 && valueType <= itDOUBLE) || ((valueType & itDOMAINITEM) != 0)) {
-                    double value;
-                    if (tbl.get(j,i,value)) {
-                       varlist[j] =  conv.raw2real(value);
-                    }
-                } else if (valueType == itSTRING ) {
-                    QString value;
-                    if (tbl.get(j,i,value)) {
-                        varlist[j] = value;
-                    }
-                }
-            }
+            // whole columns are decoded straight into the values the table takes, the column type is checked once
+            if ( (valueType >= itINT8 && valueType <= itDOUBLE) || ((valueType & itDOMAINITEM) != 0))
+                tbl.get(i, varlist, conv);
+            else if (valueType == itSTRING )
+                tbl.get(i, varlist);
             table->column(colName,varlist);
         } else {
             kernel()->issues()->log(TR(ERR_NO_OBJECT_TYPE_FOR_2).arg("column", colName));
@@ -170,27 +166,130 @@ bool TableConnector::loadBinaryData(IlwisObject* data ) {
 
 bool TableConnector::storeBinaryData(IlwisObject *obj)
 {
+    {
+        Locker lock(_mutex); // the data file changes, the indexes built on it are stale
+        _keyIndexes.clear();
+    }
     const Table *tbl = static_cast<const Table *>(obj);
 
     int skip = iUNDEF;
     BinaryIlwis3Table ilw3tbl;
     std::ofstream output_file;
-    if(!ilw3tbl.openOutput(obj->name()  + ".tb#", output_file))
-        return false;
-
+    QString dataFile = obj->name()  + ".tb#";
     for(int i=0; i < tbl->columns(); ++i) {
         const ColumnDefinition& def = tbl->columndefinition(i);
         if ( def.name() == FEATUREIDCOLUMN)
             skip = i;
         ilw3tbl.addStoreDefinition(def.datadef());
     }
-    for(int y=0; y < tbl->records(); ++y) {
-        std::vector<QVariant> rec = tbl->record(y);
-        ilw3tbl.storeRecord(output_file, rec, skip);
+    // the columns are read from the table once and written in batches of typed values, not one stream call per cell
+    const quint32 BATCH = 65536;
+    quint32 records = tbl->records();
+    QString outputFile = BinaryIlwis3Table::outputPath(dataFile);
+    QString layout = ilw3tbl.storeLayout(skip);
+    std::vector<std::vector<QVariant>> values(tbl->columns());
+    std::vector<BinaryIlwis3Table::ColumnBatch> columns(tbl->columns());
+    quint32 fetched = 0; // first record in values
+    auto fetch = [&](quint32 first, quint32 last) {
+        fetched = first;
+        for(int i=0; i < tbl->columns(); ++i) {
+            if ( i != skip)
+                values[i] = tbl->column(tbl->columndefinition(i).name(), first, last);
+        }
+    };
+    auto fillBatch = [&](quint32 first, quint32 count) {
+        for(int i=0; i < tbl->columns(); ++i) {
+            if ( i != skip)
+                ilw3tbl.columnBatch(i, values[i], first - fetched, count, columns[i]);
+        }
+    };
+
+    // in append mode only the records behind those of the last binary store are fetched and written. The ODF
+    // keeps their count, the size of the data file and the column layout; of the stored records only the last
+    // one is compared with what would be written now. Changes to the earlier records are not detected
+    quint32 first = 0;
+    bool append = false;
+    if ( appendRequested() && storedRecords(itTABLE, outputFile, records, layout, first)) {
+        append = true;
+        if ( first > 0) {
+            std::vector<char> buffer;
+            std::vector<quint64> ends;
+            fetch(first - 1, first);
+            fillBatch(first - 1, 1);
+            ilw3tbl.encodeColumns(columns, skip, buffer, ends);
+            append = endsWith(outputFile, buffer.data(), buffer.size());
+        }
+        if ( !append)
+            first = 0;
+    }
+    if(!ilw3tbl.openOutput(dataFile, output_file, append))
+        return false;
 
+    fetch(first, records);
+    for(quint32 y=first; y < records; y += BATCH) {
+        fillBatch(y, std::min(BATCH, records - y));
+        ilw3tbl.storeColumns(output_file, columns, skip);
     }
 
     output_file.close();
+    setStoredData(itTABLE, records, outputFile, layout);
+    return true;
+}
+
+bool TableConnector::buildKeyIndex(const QString &column, bool persist)
+{
+    Locker lock(_mutex);
+    return createKeyIndex(column, persist);
+}
+
+quint32 TableConnector::keyRow(const QString &column, qint64 key)
+{
+    Locker lock(_mutex);
+    auto iter = _keyIndexes.find(column);
+    if ( iter == _keyIndexes.end()) { // built on first use
+        if (!createKeyIndex(column, true))
+            return iUNDEF;
+        iter = _keyIndexes.find(column);
+    }
+    return iter.value()->row(key);
+}
+
+bool TableConnector::createKeyIndex(const QString &column, bool persist)
+{
+    if ( _keyIndexes.contains(column))
+        return true;
+    QString datafile = _odf->value("TableStore", "Data");
+    datafile = context()->workingCatalog()->filesystemLocation().toLocalFile() + "/" + datafile;
+    QFileInfo inf(datafile);
+    if ( !inf.exists()) {
+        kernel()->issues()->log(TR(ERR_MISSING_DATA_FILE_1).arg(datafile));
+        return false;
+    }
+    QString storeType = _odf->value("Col:" + column, "StoreType");
+    if ( storeType != "Long" && storeType != "Int" && storeType != "Byte" && storeType != "Real") { // only numeric columns hold keys
+        kernel()->issues()->log(TR(ERR_INVALID_PROPERTY_FOR_2).arg("key column", column));
+        return false;
+    }
+    // the sidecar is only used while the data file has the size and time it was built from
+    QString indexFile = datafile + "." + column + ".kix";
+    QSharedPointer<KeyIndex> index(new KeyIndex());
+    if ( !index->load(indexFile, inf)) {
+        BinaryIlwis3Table tbl;
+        if (!tbl.load(_odf, "", {column}))
+            return false;
+        quint32 col = tbl.index(column);
+        if ( col == iUNDEF) {
+            kernel()->issues()->log(TR(ERR_NO_OBJECT_TYPE_FOR_2).arg("column", column));
+            return false;
+        }
+        std::vector<double> keys;
+        if (!tbl.get(col, keys, Ilwis3Range::converter(_odf, "Col:" + column)))
+            return false;
+        index->build(keys);
+        if ( persist)
+            index->store(indexFile, inf);
+    }
+    _keyIndexes[column] = index;
     return true;
 }
 
@@ -284,6 +383,7 @@ bool TableConnector::storeMetaData(IlwisObject *obj)
 
     }
     _odf->setKeyValue("TableStore", "StoreTime", Time::now().toString());
+    keepStoredData();
     _odf->store();
     return true;
 }
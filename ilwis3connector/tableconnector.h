@@ -5,6 +5,7 @@ namespace Ilwis {
 namespace Ilwis3{
 
 class RawConverter;
+class KeyIndex;
 
 class TableConnector : public Ilwis3Connector
 {
@@ -20,14 +21,18 @@ public:
     static ConnectorInterface *create(const Ilwis::Resource &resource, bool load);
     static bool storeTable(const ITable& tbl);
     void attributeDomain(const QString& attdom);
+    bool buildKeyIndex(const QString& column, bool persist=true);
+    quint32 keyRow(const QString& column, qint64 key);
 private:
     ColumnDefinition getKeyColumn();
     ColumnDefinition makeColumn(const QString &colName, quint64 index);
     QString valueType2DataType(IlwisTypes ty);
     QString getDomainName(const IDomain &dom, bool& isSystem);
+    bool createKeyIndex(const QString& column, bool persist);
 
     QHash<QString, RawConverter> _converters;
     QString _attributeDomain;
+    QHash<QString, QSharedPointer<KeyIndex>> _keyIndexes;
 };
 }
 }